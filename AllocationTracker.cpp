@@ -0,0 +1,107 @@
+// Counting replacements of the global operator new and delete, compiled only into the
+// allocation-tracking build (-DSUPERSEARCH_TRACK_ALLOCATIONS=ON). Every allocation is
+// attributed to the calling thread's AllocationTracker phase and then served by malloc.
+
+#include <cstdlib>
+#include <new>
+
+#include "AllocationTracker.h"
+
+static void* trackedAllocate(size_t size) {
+    AllocationTracker::recordAllocation(size);
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+static void* trackedAllocateAligned(size_t size, align_val_t alignment) {
+    AllocationTracker::recordAllocation(size);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    void* pointer = aligned_alloc(align, (size + align - 1) / align * align);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+static void trackedFree(void* pointer) {
+    if (pointer != nullptr) {
+        AllocationTracker::recordFree();
+        free(pointer);
+    }
+}
+
+void* operator new(size_t size) {
+    return trackedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+    return trackedAllocate(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try {
+        return trackedAllocate(size);
+    } catch (const bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    try {
+        return trackedAllocate(size);
+    } catch (const bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    return trackedAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return trackedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, const nothrow_t&) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const nothrow_t&) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, align_val_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, align_val_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, align_val_t) noexcept {
+    trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t, align_val_t) noexcept {
+    trackedFree(pointer);
+}
@@ -0,0 +1,202 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+/**
+ * @class AllocationTracker
+ * @brief Counts heap allocations and bytes per phase (load, parse, analyze, insert, query) in a
+ * dedicated build. Configuring with -DSUPERSEARCH_TRACK_ALLOCATIONS=ON compiles
+ * AllocationTracker.cpp, which replaces the global operator new and delete with counting
+ * versions. In a normal build isEnabled() is false, phase scopes compile to nothing and every
+ * snapshot is empty.
+ */
+class AllocationTracker {
+   public:
+    enum Phase { OTHER, LOAD, PARSE, ANALYZE, INSERT, QUERY, PHASE_COUNT };
+
+    /**
+     * @struct Counts
+     * @brief Allocation totals per phase, plus frees of any phase.
+     */
+    struct Counts {
+        uint64_t allocations[PHASE_COUNT] = {};
+        uint64_t bytes[PHASE_COUNT] = {};
+        uint64_t frees = 0;
+
+        uint64_t totalAllocations() const {
+            uint64_t total = 0;
+            for (uint64_t count : allocations) {
+                total += count;
+            }
+            return total;
+        }
+
+        uint64_t totalBytes() const {
+            uint64_t total = 0;
+            for (uint64_t count : bytes) {
+                total += count;
+            }
+            return total;
+        }
+
+        /**
+         * @brief Returns what was allocated between an earlier snapshot and this one.
+         */
+        Counts since(const Counts& earlier) const {
+            Counts delta;
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                delta.allocations[phase] = allocations[phase] - earlier.allocations[phase];
+                delta.bytes[phase] = bytes[phase] - earlier.bytes[phase];
+            }
+            delta.frees = frees - earlier.frees;
+            return delta;
+        }
+    };
+
+   private:
+    // Constant-initialized, so the allocation hooks never run a static initializer
+    static atomic<uint64_t>* allocationCounters() {
+        static atomic<uint64_t> counters[PHASE_COUNT] = {};
+        return counters;
+    }
+
+    static atomic<uint64_t>* byteCounters() {
+        static atomic<uint64_t> counters[PHASE_COUNT] = {};
+        return counters;
+    }
+
+    static atomic<uint64_t>& freeCounter() {
+        static atomic<uint64_t> counter(0);
+        return counter;
+    }
+
+    static Phase& currentPhase() {
+        static thread_local Phase phase = OTHER;
+        return phase;
+    }
+
+   public:
+    /**
+     * @brief Returns true in the allocation-tracking build.
+     */
+    static constexpr bool isEnabled() {
+#ifdef SUPERSEARCH_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Returns the display name of a phase.
+     */
+    static const char* phaseName(Phase phase) {
+        static const char* const names[PHASE_COUNT] = {"other", "load", "parse", "analyze", "insert", "query"};
+        return names[phase];
+    }
+
+    /**
+     * @brief Returns the phase the calling thread's allocations are attributed to.
+     */
+    static Phase getPhase() {
+        return isEnabled() ? currentPhase() : OTHER;
+    }
+
+    /**
+     * @brief Attributes the calling thread's following allocations to `phase`.
+     */
+    static void setPhase(Phase phase) {
+        if (isEnabled()) {
+            currentPhase() = phase;
+        }
+    }
+
+    /**
+     * @class Scope
+     * @brief Attributes allocations to a phase for the lifetime of a scope, then restores the previous phase.
+     */
+    class Scope {
+        Phase previous;
+
+       public:
+        explicit Scope(Phase phase) : previous(getPhase()) {
+            setPhase(phase);
+        }
+
+        ~Scope() {
+            setPhase(previous);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    /**
+     * @brief Counts one allocation of `size` bytes against the calling thread's phase (called by operator new).
+     */
+    static void recordAllocation(size_t size) {
+        Phase phase = currentPhase();
+        allocationCounters()[phase].fetch_add(1, memory_order_relaxed);
+        byteCounters()[phase].fetch_add(size, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Counts one release (called by operator delete).
+     */
+    static void recordFree() {
+        freeCounter().fetch_add(1, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the totals so far on all threads; subtract an earlier snapshot with Counts::since.
+     */
+    static Counts snapshot() {
+        Counts counts;
+        if (isEnabled()) {
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                counts.allocations[phase] = allocationCounters()[phase].load(memory_order_relaxed);
+                counts.bytes[phase] = byteCounters()[phase].load(memory_order_relaxed);
+            }
+            counts.frees = freeCounter().load(memory_order_relaxed);
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Prints allocations and bytes per phase, in total and per unit of work.
+     * @param out The stream to print to.
+     * @param counts The allocations to report, usually the difference of two snapshots.
+     * @param units How many units of work (documents, queries) the allocations served.
+     * @param unitName The unit's name for the column headers.
+     */
+    static void printTable(ostream& out, const Counts& counts, size_t units, const string& unitName) {
+        double perUnit = units > 0 ? 1.0 / units : 0;
+        out << left << setw(10) << "phase" << right << setw(14) << "allocations" << setw(16) << "bytes" << setw(18)
+            << ("allocs/" + unitName) << setw(18) << ("bytes/" + unitName) << "\n";
+        out << fixed << setprecision(1);
+        for (int phase = 0; phase <= PHASE_COUNT; ++phase) {
+            bool total = phase == PHASE_COUNT;
+            uint64_t allocations = total ? counts.totalAllocations() : counts.allocations[phase];
+            uint64_t bytes = total ? counts.totalBytes() : counts.bytes[phase];
+            if (allocations == 0 && !total) {
+                continue;
+            }
+            out << left << setw(10) << (total ? "total" : phaseName(static_cast<Phase>(phase))) << right << setw(14)
+                << allocations << setw(16) << bytes << setw(18) << allocations * perUnit << setw(18)
+                << bytes * perUnit << "\n";
+        }
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+        out << "Frees: " << counts.frees << "\n";
+    }
+};
+
+#endif  // ALLOCATION_TRACKER_H
@@ -7,6 +7,9 @@
 #include <map>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "MemoryAccounting.h"
 
 using namespace std;
 
@@ -18,6 +21,56 @@ using namespace std;
  */
 template <typename Comparable>
 class AvlTree {
+   public:
+    /**
+     * @struct TermStats
+     * @brief Collection statistics kept in each dictionary entry, so they are available
+     *        without reading the entry's postings.
+     */
+    struct TermStats {
+        int documentFrequency = 0;           // Number of documents containing the key
+        long long collectionFrequency = 0;   // Total occurrences of the key across all documents
+        int maxTermFrequency = 0;            // Highest frequency of the key in a single document
+    };
+
+    /**
+     * @struct MemoryUsage
+     * @brief Estimated heap bytes held by the tree, split by what holds them.
+     */
+    struct MemoryUsage {
+        size_t nodes = 0;
+        size_t postings = 0;
+        size_t nodeBytes = 0;                // AVL nodes, including their inline key and map headers
+        size_t keyBytes = 0;                 // Key characters that do not fit inline
+        size_t postingBytes = 0;             // Map nodes of the posting lists
+        size_t documentNameBytes = 0;        // Document names in the postings that do not fit inline
+        size_t rankedPostingBytes = 0;       // Document-ID-ordered copies of long posting lists
+        vector<size_t> postingListSizes;     // Number of keys with 2^i <= postings < 2^(i+1)
+
+        size_t totalBytes() const {
+            return nodeBytes + keyBytes + postingBytes + documentNameBytes + rankedPostingBytes;
+        }
+
+        /**
+         * @brief Adds another tree's usage, e.g. to total the same tree across time partitions.
+         */
+        void add(const MemoryUsage &other) {
+            nodes += other.nodes;
+            postings += other.postings;
+            nodeBytes += other.nodeBytes;
+            keyBytes += other.keyBytes;
+            postingBytes += other.postingBytes;
+            documentNameBytes += other.documentNameBytes;
+            rankedPostingBytes += other.rankedPostingBytes;
+            if (postingListSizes.size() < other.postingListSizes.size()) {
+                postingListSizes.resize(other.postingListSizes.size(), 0);
+            }
+            for (size_t bucket = 0; bucket < other.postingListSizes.size(); ++bucket) {
+                postingListSizes[bucket] += other.postingListSizes[bucket];
+            }
+        }
+    };
+
    private:
     struct AvlNode {
         Comparable key;                      // The key stored in the node
@@ -25,6 +78,8 @@ class AvlTree {
         AvlNode *right;                      // Pointer to the right child
         int height;                          // Height of the node
         map<string, int> wordMap;            // Map of document IDs to frequencies
+        TermStats stats;                     // Statistics over wordMap, maintained on insert
+        vector<pair<int, int>> rankedPostings;  // (document ID, frequency) in ID order; long lists only
 
         // Constructor for AvlNode
         AvlNode(const Comparable &theKey, AvlNode *lt = nullptr, AvlNode *rt = nullptr, int h = 0)
@@ -32,11 +87,356 @@ class AvlTree {
     };
 
     size_t uniqueTokens = 0;   // Tracks the number of unique keys in the tree
+    bool rankedPostingsBuilt = false;  // True until an insert makes the ranked postings stale
     AvlNode *root;             // Root node of the tree
 
     // The allowed imbalance factor for the AVL tree. A higher value reduces rebalancing but may affect search efficiency.
     static const int ALLOWED_IMBALANCE = 1;
 
+    /**
+     * @brief Recursively visits the nodes of a subtree in key order.
+     * @param t The root of the subtree.
+     * @param visit Called with each node's key and document-frequency map.
+     */
+    template <typename Visitor>
+    void forEachNode(AvlNode *t, Visitor &visit) const {
+        if (t == nullptr) {
+            return;
+        }
+        forEachNode(t->left, visit);
+        visit(t->key, t->wordMap);
+        forEachNode(t->right, visit);
+    }
+
+    /**
+     * @brief Builds the document-ID-ordered postings of every long posting list in a subtree.
+     *        A list with a document `documentIDOf` cannot resolve keeps no ranked copy.
+     */
+    template <typename IdOf>
+    void buildRankedPostings(AvlNode *t, IdOf &documentIDOf, size_t minPostings) {
+        if (t == nullptr) {
+            return;
+        }
+        t->rankedPostings.clear();
+        if (t->wordMap.size() >= minPostings) {
+            t->rankedPostings.reserve(t->wordMap.size());
+            for (const auto &posting : t->wordMap) {
+                int docID = documentIDOf(posting.first);
+                if (docID < 0) {
+                    t->rankedPostings.clear();
+                    break;
+                }
+                t->rankedPostings.emplace_back(docID, posting.second);
+            }
+            sort(t->rankedPostings.begin(), t->rankedPostings.end());
+            t->rankedPostings.shrink_to_fit();
+        }
+        buildRankedPostings(t->left, documentIDOf, minPostings);
+        buildRankedPostings(t->right, documentIDOf, minPostings);
+    }
+
+    /**
+     * @brief Returns the heap bytes held by the ranked postings of a subtree.
+     */
+    size_t rankedPostingBytes(const AvlNode *t) const {
+        if (t == nullptr) {
+            return 0;
+        }
+        size_t bytes = t->rankedPostings.empty() ? 0 : MemoryAccounting::allocationBytes(
+                                                            t->rankedPostings.capacity() * sizeof(pair<int, int>));
+        return bytes + rankedPostingBytes(t->left) + rankedPostingBytes(t->right);
+    }
+
+    /**
+     * @brief Returns the heap bytes owned by a string key.
+     */
+    static size_t keyHeapBytes(const string &key) {
+        return MemoryAccounting::stringHeapBytes(key);
+    }
+
+    /**
+     * @brief Returns the heap bytes owned by any other key type, assumed to hold none.
+     */
+    template <typename Key>
+    static size_t keyHeapBytes(const Key &) {
+        return 0;
+    }
+
+    /**
+     * @brief Copies the term statistics of a subtree onto its clone, which has the same shape.
+     */
+    void copyStats(const AvlNode *from, AvlNode *to) {
+        if (from == nullptr || to == nullptr) {
+            return;
+        }
+        to->stats = from->stats;
+        copyStats(from->left, to->left);
+        copyStats(from->right, to->right);
+    }
+
+    /**
+     * @brief Writes one node as a "key:df,cf,maxTf:(doc,freq)..." line.
+     */
+    void writeLine(const AvlNode *t, ofstream &out) const {
+        out << t->key << ":" << t->stats.documentFrequency << "," << t->stats.collectionFrequency << ","
+            << t->stats.maxTermFrequency << ":";
+        for (const auto &posting : t->wordMap) {
+            out << "(" << posting.first << "," << posting.second << ")";
+        }
+        out << "\n";
+    }
+
+    /**
+     * @brief Writes a subtree in pre-order, so reading the file back rebuilds the tree with few rotations.
+     */
+    void writeNode(const AvlNode *t, ofstream &out) const {
+        if (t == nullptr) {
+            return;
+        }
+        writeLine(t, out);
+        writeNode(t->left, out);
+        writeNode(t->right, out);
+    }
+
+    /**
+     * @brief Writes a subtree in key order.
+     */
+    void writeInOrder(const AvlNode *t, ofstream &out) const {
+        if (t == nullptr) {
+            return;
+        }
+        writeInOrder(t->left, out);
+        writeLine(t, out);
+        writeInOrder(t->right, out);
+    }
+
+    /**
+     * @brief Walks a subtree in key order, deleting nodes that match the predicate and
+     *        collecting the others.
+     */
+    template <typename Predicate>
+    void collectOrDelete(AvlNode *t, Predicate &shouldRemove, vector<AvlNode *> &kept, size_t &removed) {
+        if (t == nullptr) {
+            return;
+        }
+        AvlNode *right = t->right;
+        collectOrDelete(t->left, shouldRemove, kept, removed);
+        if (shouldRemove(t->key, t->wordMap)) {
+            delete t;
+            ++removed;
+        } else {
+            kept.push_back(t);
+        }
+        collectOrDelete(right, shouldRemove, kept, removed);
+    }
+
+    /**
+     * @brief Relinks sorted nodes [lo, hi) into a perfectly balanced subtree.
+     * @return The root of the subtree.
+     */
+    AvlNode *buildBalanced(vector<AvlNode *> &nodes, size_t lo, size_t hi) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        AvlNode *t = nodes[mid];
+        t->left = buildBalanced(nodes, lo, mid);
+        t->right = buildBalanced(nodes, mid + 1, hi);
+        int leftHeight = t->left ? t->left->height : -1;
+        int rightHeight = t->right ? t->right->height : -1;
+        t->height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+        return t;
+    }
+
+    /**
+     * @brief Adds a posting to a node and keeps the node's statistics in step with its postings.
+     */
+    static void addPosting(AvlNode *t, const string &documentID, int frequency) {
+        int &termFrequency = t->wordMap[documentID];
+        termFrequency += frequency;
+        t->stats.documentFrequency = static_cast<int>(t->wordMap.size());
+        t->stats.collectionFrequency += frequency;
+        if (termFrequency > t->stats.maxTermFrequency) {
+            t->stats.maxTermFrequency = termFrequency;
+        }
+    }
+
+    /**
+     * @brief Recursively inserts a key with document ID and frequency into a subtree and rebalances it.
+     * @param t The root of the subtree, updated if a rotation replaces it.
+     */
+    void insert(const Comparable &x, const string &documentID, int frequency, AvlNode *&t) {
+        if (t == nullptr) {
+            t = new AvlNode{x};
+            addPosting(t, documentID, frequency);
+            ++uniqueTokens;
+            return;
+        }
+
+        if (x < t->key) {
+            insert(x, documentID, frequency, t->left);
+        } else if (t->key < x) {
+            insert(x, documentID, frequency, t->right);
+        } else {
+            addPosting(t, documentID, frequency); // Existing key: no change in shape
+            return;
+        }
+        balance(t);
+    }
+
+    /**
+     * @brief Checks if a subtree contains a given key.
+     */
+    bool contains(const Comparable &x, AvlNode *t) const {
+        return findNode(x, t) != nullptr;
+    }
+
+    /**
+     * @brief Finds the node with the specified key in a subtree, iteratively.
+     * @return A pointer to the node, or nullptr if not found.
+     */
+    AvlNode *findNode(const Comparable &x, AvlNode *t) const {
+        while (t != nullptr) {
+            if (x < t->key) {
+                t = t->left;
+            } else if (t->key < x) {
+                t = t->right;
+            } else {
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Deletes all nodes of a subtree and sets its root to nullptr.
+     */
+    void makeEmpty(AvlNode *&t) {
+        if (t != nullptr) {
+            makeEmpty(t->left);
+            makeEmpty(t->right);
+            delete t;
+        }
+        t = nullptr;
+        uniqueTokens = 0;
+    }
+
+    /**
+     * @brief Deep-copies a subtree, including each node's document-frequency map.
+     * @return The root of the copy.
+     */
+    AvlNode *clone(AvlNode *t) const {
+        if (t == nullptr) {
+            return nullptr;
+        }
+        AvlNode *copy = new AvlNode{t->key, clone(t->left), clone(t->right), t->height};
+        copy->wordMap = t->wordMap;
+        copy->rankedPostings = t->rankedPostings;
+        return copy;
+    }
+
+    /**
+     * @brief Prints a subtree sideways, right children first.
+     */
+    void prettyPrintTree(const string &prefix, const AvlNode *node, bool isRight) const {
+        if (node == nullptr) {
+            return;
+        }
+        cout << prefix << (isRight ? "├──" : "└──") << node->key << endl;
+        prettyPrintTree(prefix + (isRight ? "│   " : "    "), node->right, true);
+        prettyPrintTree(prefix + (isRight ? "│   " : "    "), node->left, false);
+    }
+
+    /**
+     * @brief Returns the height of a node, or -1 for nullptr.
+     */
+    int height(const AvlNode *t) const {
+        return t == nullptr ? -1 : t->height;
+    }
+
+    /**
+     * @brief Restores the AVL property at a node after an insert below it, and updates its height.
+     */
+    void balance(AvlNode *&t) {
+        if (t == nullptr) {
+            return;
+        }
+
+        if (height(t->left) - height(t->right) > ALLOWED_IMBALANCE) {
+            if (height(t->left->left) >= height(t->left->right)) {
+                rotateWithLeftChild(t);
+            } else {
+                doubleWithLeftChild(t);
+            }
+        } else if (height(t->right) - height(t->left) > ALLOWED_IMBALANCE) {
+            if (height(t->right->right) >= height(t->right->left)) {
+                rotateWithRightChild(t);
+            } else {
+                doubleWithRightChild(t);
+            }
+        }
+        t->height = std::max(height(t->left), height(t->right)) + 1;
+    }
+
+    /**
+     * @brief Single rotation for case 1 (left child's left subtree is too tall).
+     */
+    void rotateWithLeftChild(AvlNode *&k2) {
+        AvlNode *k1 = k2->left;
+        k2->left = k1->right;
+        k1->right = k2;
+        k2->height = std::max(height(k2->left), height(k2->right)) + 1;
+        k1->height = std::max(height(k1->left), k2->height) + 1;
+        k2 = k1;
+    }
+
+    /**
+     * @brief Single rotation for case 4 (right child's right subtree is too tall).
+     */
+    void rotateWithRightChild(AvlNode *&k1) {
+        AvlNode *k2 = k1->right;
+        k1->right = k2->left;
+        k2->left = k1;
+        k1->height = std::max(height(k1->left), height(k1->right)) + 1;
+        k2->height = std::max(height(k2->right), k1->height) + 1;
+        k1 = k2;
+    }
+
+    /**
+     * @brief Double rotation for case 2 (left child's right subtree is too tall).
+     */
+    void doubleWithLeftChild(AvlNode *&k3) {
+        rotateWithRightChild(k3->left);
+        rotateWithLeftChild(k3);
+    }
+
+    /**
+     * @brief Double rotation for case 3 (right child's left subtree is too tall).
+     */
+    void doubleWithRightChild(AvlNode *&k1) {
+        rotateWithLeftChild(k1->right);
+        rotateWithRightChild(k1);
+    }
+
+#ifdef DEBUG
+    /**
+     * @brief Recursively validates the balance and stored height of a subtree.
+     * @return The subtree's height.
+     */
+    int check_balance(AvlNode *t) {
+        if (t == nullptr) {
+            return -1;
+        }
+        int leftHeight = check_balance(t->left);
+        int rightHeight = check_balance(t->right);
+        if (leftHeight - rightHeight > ALLOWED_IMBALANCE || rightHeight - leftHeight > ALLOWED_IMBALANCE ||
+            t->height != std::max(leftHeight, rightHeight) + 1) {
+            throw invalid_argument("tree is not balanced");
+        }
+        return t->height;
+    }
+#endif
+
    public:
 
     /**
@@ -58,6 +458,8 @@ class AvlTree {
      */
     AvlTree(const AvlTree &rhs) : root{nullptr} {
         root = clone(rhs.root);
+        copyStats(rhs.root, root);
+        rankedPostingsBuilt = rhs.rankedPostingsBuilt;
     }
 
     /**
@@ -76,6 +478,8 @@ class AvlTree {
         if (this != &rhs) {
             makeEmpty();
             root = clone(rhs.root);
+            copyStats(rhs.root, root);
+            rankedPostingsBuilt = rhs.rankedPostingsBuilt;
         }
         return *this;
     }
@@ -108,6 +512,97 @@ class AvlTree {
         return node ? node->wordMap : map<string, int>();
     }
 
+    /**
+     * @brief Retrieves the collection statistics for a specific key without copying its postings.
+     * @param key The key to search for.
+     * @return The key's statistics, or all zeros if the key is not found.
+     */
+    TermStats getTermStats(const Comparable &key) const {
+        AvlNode *node = findNode(key);
+        return node ? node->stats : TermStats();
+    }
+
+    /**
+     * @brief Copies each long posting list into a vector of (document ID, frequency) sorted by
+     *        document ID. When IDs follow descending static score, a ranked scan of such a list
+     *        can stop as soon as no later document can enter the top results. Inserting into
+     *        the tree invalidates the copies until they are built again.
+     * @param documentIDOf A callable mapping a document path to its ID, or -1 if it has none.
+     * @param minPostings Shorter lists are cheap to rank from the map and get no copy.
+     */
+    template <typename IdOf>
+    void buildRankedPostings(IdOf documentIDOf, size_t minPostings = 64) {
+        buildRankedPostings(root, documentIDOf, max<size_t>(1, minPostings));
+        rankedPostingsBuilt = true;
+    }
+
+    /**
+     * @brief Retrieves the document-ID-ordered postings of a key built by buildRankedPostings.
+     * @param key The key to search for.
+     * @return The postings, or nullptr if the key is missing, its list has no ranked copy, or
+     *         the tree changed since the copies were built.
+     */
+    const vector<pair<int, int>> *getRankedPostings(const Comparable &key) const {
+        AvlNode *node = rankedPostingsBuilt ? findNode(key) : nullptr;
+        return node != nullptr && !node->rankedPostings.empty() ? &node->rankedPostings : nullptr;
+    }
+
+    /**
+     * @brief Estimates the heap memory held by the tree and histograms its posting-list sizes.
+     *        Runs in time linear in the number of postings.
+     */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        size_t nodeSize = MemoryAccounting::allocationBytes(sizeof(AvlNode));
+        size_t postingSize = MemoryAccounting::mapNodeBytes<pair<const string, int>>();
+        forEachNode([&](const Comparable &key, const map<string, int> &wordMap) {
+            ++usage.nodes;
+            usage.nodeBytes += nodeSize;
+            usage.keyBytes += keyHeapBytes(key);
+            usage.postings += wordMap.size();
+            usage.postingBytes += wordMap.size() * postingSize;
+            for (const auto &posting : wordMap) {
+                usage.documentNameBytes += MemoryAccounting::stringHeapBytes(posting.first);
+            }
+
+            size_t bucket = 0;
+            while ((wordMap.size() >> (bucket + 1)) != 0) {
+                ++bucket;
+            }
+            if (usage.postingListSizes.size() <= bucket) {
+                usage.postingListSizes.resize(bucket + 1, 0);
+            }
+            ++usage.postingListSizes[bucket];
+        });
+        usage.rankedPostingBytes = rankedPostingBytes(root);
+        return usage;
+    }
+
+    /**
+     * @brief Visits every key with its document-frequency map, in key order.
+     * @param visit A callable taking (const Comparable &key, const map<string, int> &wordMap).
+     */
+    template <typename Visitor>
+    void forEachNode(Visitor visit) const {
+        forEachNode(root, visit);
+    }
+
+    /**
+     * @brief Removes every key whose node matches a predicate, then relinks the remaining
+     *        nodes into a balanced tree. Runs in linear time, which suits bulk pruning.
+     * @param shouldRemove A callable taking (const Comparable &key, const map<string, int> &wordMap).
+     * @return The number of keys removed.
+     */
+    template <typename Predicate>
+    size_t removeKeysIf(Predicate shouldRemove) {
+        vector<AvlNode *> kept;
+        size_t removed = 0;
+        collectOrDelete(root, shouldRemove, kept, removed);
+        root = buildBalanced(kept, 0, kept.size());
+        uniqueTokens = kept.size();
+        return removed;
+    }
+
     /**
      * @brief Checks if the tree is empty.
      * @return True if the tree has no nodes, false otherwise.
@@ -128,6 +623,7 @@ class AvlTree {
      */
     void makeEmpty() {
         makeEmpty(root);
+        rankedPostingsBuilt = false;
     }
 
     /**
@@ -139,6 +635,7 @@ class AvlTree {
      */
     void insert(const Comparable &x, const string &documentID, int frequency) {
         insert(x, documentID, frequency, root);
+        rankedPostingsBuilt = false;
     }
 
     /**
@@ -151,12 +648,30 @@ class AvlTree {
             cerr << "Error: Unable to open file " << filename << " for writing." << endl;
             return;
         }
-        writeHelper(root, outFile);
+        writeNode(root, outFile);
         outFile.close();
     }
 
     /**
-     * @brief Reads tree data from a text file and reconstructs the tree.
+     * @brief Writes the tree in key order, in the same line format as writeToTextFile. Sorted
+     *        files can be merged line by line (see SpimiIndexer) and read back with readFromTextFile.
+     * @param filename The name of the file to write to.
+     * @return False if the file could not be written.
+     */
+    bool writeSortedToTextFile(const string &filename) const {
+        ofstream outFile(filename);
+        if (!outFile) {
+            cerr << "Error: Unable to open file " << filename << " for writing." << endl;
+            return false;
+        }
+        writeInOrder(root, outFile);
+        return static_cast<bool>(outFile);
+    }
+
+    /**
+     * @brief Reads tree data from a text file and reconstructs the tree. Term statistics
+     *        stored in the file replace the ones recomputed from the postings; files
+     *        without them (plain "key:(doc,freq)..." lines) are still accepted.
      * @param filename The name of the file to read from.
      */
     void readFromTextFile(const string &filename) {
@@ -178,6 +693,25 @@ class AvlTree {
             }
             key = line.substr(0, colonPos);
 
+            // Optional "df,cf,maxTf:" statistics between the key and the postings
+            TermStats stored;
+            bool hasStats = false;
+            size_t statsEnd = line.find(':', colonPos + 1);
+            if (colonPos + 1 < line.size() && line[colonPos + 1] != '(' && statsEnd != string::npos) {
+                string fields = line.substr(colonPos + 1, statsEnd - colonPos - 1);
+                size_t first = fields.find(',');
+                size_t second = first == string::npos ? string::npos : fields.find(',', first + 1);
+                if (second == string::npos) {
+                    cerr << "Error: Invalid file format. Term statistics malformed." << endl;
+                    continue;
+                }
+                stored.documentFrequency = stoi(fields.substr(0, first));
+                stored.collectionFrequency = stoll(fields.substr(first + 1, second - first - 1));
+                stored.maxTermFrequency = stoi(fields.substr(second + 1));
+                hasStats = true;
+                colonPos = statsEnd;
+            }
+
             size_t openParenPos, commaPos, closeParenPos;
             while ((openParenPos = line.find('(', colonPos)) != string::npos) {
                 commaPos = line.find(',', openParenPos);
@@ -191,6 +725,10 @@ class AvlTree {
                 insert(key, docID, frequency);
                 colonPos = closeParenPos + 1;
             }
+            AvlNode *node = hasStats ? findNode(key) : nullptr;
+            if (node != nullptr) {
+                node->stats = stored;
+            }
         }
         inFile.close();
     }
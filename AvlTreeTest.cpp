@@ -1,5 +1,13 @@
 #define CATCH_CONFIG_MAIN
+#include <filesystem>
+#ifdef SUPERSEARCH_HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include "AvlTree.h"
+#include "DirectoryWalker.h"
+#include "FilePrefetcher.h"
+#include "JsonRecordReader.h"
+#include "SpimiIndexer.h"
 #include "catch2/catch.hpp"
 
 using namespace std;
@@ -127,8 +135,10 @@ TEST_CASE("AVL Tree Persistence") {
     test1.insert("test", "doc2", 7);
     test1.insert("data", "doc3", 10);
 
-    test1.writeToTextFile("testPersistence.txt");
-    test2.readFromTextFile("testPersistence.txt");
+    string persistenceFile = (filesystem::temp_directory_path() / "supersearch_testPersistence.txt").string();
+    test1.writeToTextFile(persistenceFile);
+    test2.readFromTextFile(persistenceFile);
+    filesystem::remove(persistenceFile);
 
     // Verify the second tree has identical contents
     REQUIRE(test2.contains("example"));
@@ -141,3 +151,363 @@ TEST_CASE("AVL Tree Persistence") {
     REQUIRE(exampleMap["doc1"] == 5);
     REQUIRE(exampleMap["doc5"] == 9);
 }
+
+// Test case for the per-term statistics kept in each dictionary entry
+TEST_CASE("AVL Tree Term Statistics") {
+    AvlTree<string> test1;
+    AvlTree<string> test2;
+
+    test1.insert("example", "doc1", 5);
+    test1.insert("example", "doc5", 9);
+    test1.insert("example", "doc1", 2);
+    test1.insert("data", "doc3", 10);
+
+    auto stats = test1.getTermStats("example");
+    REQUIRE(stats.documentFrequency == 2);
+    REQUIRE(stats.collectionFrequency == 16);
+    REQUIRE(stats.maxTermFrequency == 9);
+    REQUIRE(test1.getTermStats("missing").documentFrequency == 0);
+
+    // Statistics survive persistence and copying
+    string statisticsFile = (filesystem::temp_directory_path() / "supersearch_testStatistics.txt").string();
+    test1.writeToTextFile(statisticsFile);
+    test2.readFromTextFile(statisticsFile);
+    filesystem::remove(statisticsFile);
+    REQUIRE(test2.getTermStats("example").collectionFrequency == 16);
+    REQUIRE(test2.getTermStats("data").maxTermFrequency == 10);
+
+    AvlTree<string> copy(test2);
+    REQUIRE(copy.getTermStats("example").documentFrequency == 2);
+}
+
+// Test case for visiting every node of the AVL tree
+TEST_CASE("AVL Tree Traversal") {
+    AvlTree<string> avlTree;
+
+    avlTree.insert("test", "doc1", 7);
+    avlTree.insert("example", "doc1", 5);
+    avlTree.insert("example", "doc2", 3);
+    avlTree.insert("data", "doc3", 10);
+
+    vector<string> keys;
+    size_t postings = 0;
+    avlTree.forEachNode([&](const string& key, const map<string, int>& wordMap) {
+        keys.push_back(key);
+        postings += wordMap.size();
+    });
+
+    // Keys are visited in sorted order with all of their postings
+    REQUIRE(keys == vector<string>{"data", "example", "test"});
+    REQUIRE(postings == 4);
+}
+
+// Test case for bulk removal of keys from the AVL tree
+TEST_CASE("AVL Tree Bulk Removal") {
+    AvlTree<string> avlTree;
+
+    avlTree.insert("apple", "doc1", 1);
+    avlTree.insert("banana", "doc1", 2);
+    avlTree.insert("banana", "doc2", 4);
+    avlTree.insert("cherry", "doc3", 3);
+    avlTree.insert("date", "doc1", 1);
+    avlTree.insert("elderberry", "doc2", 5);
+
+    // Remove keys that appear in a single document
+    size_t removed = avlTree.removeKeysIf([](const string&, const map<string, int>& wordMap) {
+        return wordMap.size() < 2;
+    });
+
+    REQUIRE(removed == 4);
+    REQUIRE(avlTree.getSize() == 1);
+    REQUIRE(avlTree.contains("banana"));
+    REQUIRE_FALSE(avlTree.contains("apple"));
+    REQUIRE_FALSE(avlTree.contains("elderberry"));
+    REQUIRE(avlTree.getWordMapAtKey("banana")["doc2"] == 4);
+
+    // The relinked tree still accepts inserts
+    avlTree.insert("fig", "doc4", 1);
+    REQUIRE(avlTree.contains("fig"));
+}
+
+// Test case for merging sorted runs of several trees into one index file
+TEST_CASE("Sorted Run Merge") {
+    AvlTree<string> runs[3];
+    AvlTree<string> all;
+    const vector<string> keys = {"apple", "banana", "cherry", "date", "elder", "fig", "grape"};
+
+    // Each run holds its own documents, as between SPIMI flushes; keys overlap across runs
+    for (int run = 0; run < 3; ++run) {
+        for (size_t k = run; k < keys.size(); k += run + 1) {
+            string doc = "doc" + to_string(run) + "_" + to_string(k);
+            runs[run].insert(keys[k], doc, static_cast<int>(k + run + 1));
+            all.insert(keys[k], doc, static_cast<int>(k + run + 1));
+        }
+        runs[run].insert("banana", "extra" + to_string(run), 20 + run);
+        all.insert("banana", "extra" + to_string(run), 20 + run);
+    }
+
+    filesystem::path directory = filesystem::temp_directory_path() / "supersearch_testRunMerge";
+    filesystem::create_directories(directory);
+    vector<string> runFiles;
+    for (int run = 0; run < 3; ++run) {
+        runFiles.push_back((directory / ("run" + to_string(run) + ".txt")).string());
+        REQUIRE(runs[run].writeSortedToTextFile(runFiles.back()));
+    }
+    string mergedFile = (directory / "merged.txt").string();
+    REQUIRE(SpimiIndexer::mergeRuns(runFiles, mergedFile) == all.getSize());
+
+    // The merged file is in balanced pre-order: the median key first, then the lower half's median
+    vector<string> lineKeys;
+    ifstream in(mergedFile);
+    string line;
+    while (getline(in, line)) {
+        lineKeys.push_back(line.substr(0, line.find(':')));
+    }
+    in.close();
+    REQUIRE(lineKeys.size() == keys.size());
+    REQUIRE(lineKeys[0] == keys[3]);
+    REQUIRE(lineKeys[1] == keys[1]);
+
+    AvlTree<string> merged;
+    merged.readFromTextFile(mergedFile);
+    filesystem::remove_all(directory);
+
+    REQUIRE(merged.getSize() == all.getSize());
+    all.forEachNode([&](const string& key, const map<string, int>& wordMap) {
+        REQUIRE(merged.getWordMapAtKey(key) == wordMap);
+        auto expected = all.getTermStats(key);
+        auto actual = merged.getTermStats(key);
+        REQUIRE(actual.documentFrequency == expected.documentFrequency);
+        REQUIRE(actual.collectionFrequency == expected.collectionFrequency);
+        REQUIRE(actual.maxTermFrequency == expected.maxTermFrequency);
+    });
+}
+
+// Reads every record of a file with a given buffer size, as "offset:text" strings
+static vector<string> readRecords(const string& filePath, bool lineDelimited, size_t bufferBytes) {
+    JsonRecordReader reader(filePath, lineDelimited, bufferBytes);
+    REQUIRE(reader.isOpen());
+    vector<string> texts;
+    vector<JsonRecordReader::Record> records;
+    while (reader.nextBatch(records)) {
+        for (const auto& record : records) {
+            texts.push_back(to_string(record.offset) + ":" + string(record.data, record.length));
+        }
+    }
+    return texts;
+}
+
+// Test case for splitting JSON Lines and concatenated JSON files into records
+TEST_CASE("JSON Record Reader") {
+    filesystem::path directory = filesystem::temp_directory_path() / "supersearch_testRecords";
+    filesystem::create_directories(directory);
+    auto writeFile = [&](const string& name, const string& content) {
+        string path = (directory / name).string();
+        ofstream(path, ios::binary) << content;
+        return path;
+    };
+
+    SECTION("JSON Lines, final line without a newline") {
+        string path = writeFile("lines.jsonl", "{\"a\":1}\n\n{\"b\":\"x\\ny\"}\n{\"c\":3}");
+        vector<string> expected = {"0:{\"a\":1}", "9:{\"b\":\"x\\ny\"}", "22:{\"c\":3}"};
+        REQUIRE(readRecords(path, true, 1 << 20) == expected);
+        // Records crossing buffer boundaries, and a buffer smaller than one record, read the same
+        REQUIRE(readRecords(path, true, 5) == expected);
+        REQUIRE(readRecords(path, true, 1) == expected);
+    }
+
+    SECTION("Concatenated documents with escaped quotes and braces in strings") {
+        string first = "{\"title\":\"say \\\"}\\\" now\",\"tags\":[\"{\",\"]\"],\"n\":{\"m\":[1,2]}}";
+        string second = "{\"text\":\"back\\\\\"}";
+        string path = writeFile("concatenated.json", first + "\n " + second + "\n");
+        vector<string> expected = {"0:" + first, to_string(first.size() + 2) + ":" + second};
+        REQUIRE(readRecords(path, false, 1 << 20) == expected);
+        REQUIRE(readRecords(path, false, 7) == expected);
+    }
+
+    SECTION("A top-level array of documents") {
+        string path = writeFile("array.json", "[\n  {\"a\":[1,2]},\n  {\"b\":\"],\"}\n]\n");
+        vector<string> expected = {"4:{\"a\":[1,2]}", "19:{\"b\":\"],\"}"};
+        REQUIRE(readRecords(path, false, 1 << 20) == expected);
+        REQUIRE(readRecords(path, false, 3) == expected);
+
+        string content;
+        REQUIRE(JsonRecordReader::readDocument(JsonRecordReader::makeLocator(path, 19), content));
+        REQUIRE(content == "{\"b\":\"],\"}");
+        REQUIRE_FALSE(JsonRecordReader::readDocument(JsonRecordReader::makeLocator(path, 17), content));
+    }
+
+    SECTION("Buffer growth for a record larger than the buffer") {
+        string large = "{\"body\":\"" + string(100000, 'x') + "\"}";
+        string path = writeFile("large.jsonl", "{\"a\":1}\n" + large + "\n{\"b\":2}\n");
+        vector<string> expected = {"0:{\"a\":1}", "8:" + large, to_string(9 + large.size()) + ":{\"b\":2}"};
+        REQUIRE(readRecords(path, true, 64) == expected);
+    }
+
+    SECTION("Locators") {
+        string filePath;
+        size_t offset = 0;
+        REQUIRE(JsonRecordReader::splitLocator("dump/news.jsonl#1234", filePath, offset));
+        REQUIRE(filePath == "dump/news.jsonl");
+        REQUIRE(offset == 1234);
+        REQUIRE(JsonRecordReader::splitLocator("a#b.jsonl#0", filePath, offset));
+        REQUIRE(filePath == "a#b.jsonl");
+        REQUIRE(offset == 0);
+        REQUIRE_FALSE(JsonRecordReader::splitLocator("news.json", filePath, offset));
+        REQUIRE_FALSE(JsonRecordReader::splitLocator("news.jsonl#", filePath, offset));
+        REQUIRE_FALSE(JsonRecordReader::splitLocator("news.jsonl#12a", filePath, offset));
+
+        // An existing file whose name ends in "#digits" is a whole document, not a record
+        string hashed = writeFile("issue#42", "{\"a\":1}");
+        REQUIRE_FALSE(JsonRecordReader::splitLocator(hashed, filePath, offset));
+        string content;
+        REQUIRE(JsonRecordReader::readDocument(hashed, content));
+        REQUIRE(content == "{\"a\":1}");
+    }
+
+    filesystem::remove_all(directory);
+}
+
+#ifdef SUPERSEARCH_HAVE_ZLIB
+// Test case for reading records of a gzip dump from recorded seek points
+TEST_CASE("Gzip Seek Points") {
+    filesystem::path directory = filesystem::temp_directory_path() / "supersearch_testSeekPoints";
+    filesystem::create_directories(directory);
+    string path = (directory / "dump.jsonl.gz").string();
+
+    // Two gzip members of varied JSON lines, several MiB decompressed, so points fall in both
+    vector<string> lines;
+    vector<size_t> offsets;
+    size_t offset = 0;
+    uint32_t seed = 12345;
+    for (int member = 0; member < 2; ++member) {
+        gzFile out = gzopen(path.c_str(), member == 0 ? "wb" : "ab");
+        REQUIRE(out != nullptr);
+        for (int i = 0; i < 12000; ++i) {
+            string line = "{\"id\":" + to_string(lines.size()) + ",\"text\":\"";
+            for (int word = 0; word < 30; ++word) {
+                seed = seed * 1103515245 + 12345;
+                line += "w" + to_string((seed >> 8) % 5000) + " ";
+            }
+            line += "\"}";
+            lines.push_back(line);
+            offsets.push_back(offset);
+            offset += line.size() + 1;
+            gzwrite(out, (line + "\n").data(), static_cast<unsigned>(line.size() + 1));
+        }
+        gzclose(out);
+    }
+
+    JsonRecordReader reader(path, true);
+    REQUIRE(reader.isOpen());
+    vector<JsonRecordReader::Record> records;
+    size_t recordCount = 0;
+    while (reader.nextBatch(records)) {
+        for (const auto& record : records) {
+            REQUIRE(record.offset == offsets[recordCount]);
+            ++recordCount;
+        }
+    }
+    REQUIRE(recordCount == lines.size());
+    vector<GzipFile::SeekPoint> points = reader.takeSeekPoints();
+    REQUIRE(points.size() >= 3);
+    GzipSeekIndex::add(path, points);
+
+    // Saved and loaded points find the same place as the recorded ones
+    string pointsFile = (directory / "gzipSeekPoints.bin").string();
+    REQUIRE(GzipSeekIndex::writeToFile(pointsFile));
+    GzipSeekIndex::readFromFile(pointsFile);
+    REQUIRE(GzipSeekIndex::getPointCount() == points.size());
+
+    // Records before the first point, in either member, and across the member boundary read back whole
+    vector<size_t> samples = {0, 1, 11999, 12000, 12001, lines.size() - 1};
+    for (size_t i = 0; i < lines.size(); i += 997) {
+        samples.push_back(i);
+    }
+    for (size_t i : samples) {
+        string content;
+        REQUIRE(JsonRecordReader::readDocument(JsonRecordReader::makeLocator(path, offsets[i]), content));
+        REQUIRE(content == lines[i]);
+    }
+    GzipFile::SeekPoint point;
+    REQUIRE(GzipSeekIndex::find(path, offsets.back(), point));
+    REQUIRE(point.output == points.back().output);
+    REQUIRE_FALSE(GzipSeekIndex::find(path, 0, point));
+
+    GzipSeekIndex::clear();
+    filesystem::remove_all(directory);
+}
+#endif
+
+// Test case for the order the directory walker returns files in
+TEST_CASE("Directory Walker Order") {
+    filesystem::path root = filesystem::temp_directory_path() / "supersearch_testWalk";
+    filesystem::remove_all(root);
+    vector<string> expected;
+    // Created out of name order, with files and subdirectories interleaved by name
+    for (string directory : {"m", "b", "b/z", "b/a", "b/a/deep", "q"}) {
+        filesystem::create_directories(root / directory);
+        for (string name : {"9.json", "1.json", "x.json", "A.json"}) {
+            ofstream(root / directory / name) << "{}";
+        }
+    }
+    ofstream(root / "c.json") << "{}";
+    // Depth first, each directory's entries in byte order: files and subdirectories interleave
+    string base = root.string();
+    for (string path : {"/b/1.json", "/b/9.json", "/b/A.json", "/b/a/1.json", "/b/a/9.json", "/b/a/A.json",
+                        "/b/a/deep/1.json", "/b/a/deep/9.json", "/b/a/deep/A.json", "/b/a/deep/x.json", "/b/a/x.json",
+                        "/b/x.json", "/b/z/1.json", "/b/z/9.json", "/b/z/A.json", "/b/z/x.json", "/c.json", "/m/1.json",
+                        "/m/9.json", "/m/A.json", "/m/x.json", "/q/1.json", "/q/9.json", "/q/A.json", "/q/x.json"}) {
+        expected.push_back(base + path);
+    }
+
+    // Two walks on four threads, with room for only two files ahead, return the same order
+    for (int walk = 0; walk < 2; ++walk) {
+        vector<string> found;
+        DirectoryWalker walker(base, 4, 2);
+        for (string path; walker.next(path);) {
+            found.push_back(path);
+        }
+        REQUIRE(found == expected);
+        REQUIRE(walker.getDirectoriesRead() == 7);
+    }
+    filesystem::remove_all(root);
+}
+
+// Test case for the order and contents of prefetched files
+TEST_CASE("File Prefetcher Order") {
+    filesystem::path root = filesystem::temp_directory_path() / "supersearch_testPrefetch";
+    filesystem::remove_all(root);
+    filesystem::create_directories(root / "sub");
+    vector<string> expected;
+    // Created in reverse name order, so inode order differs from walk order
+    for (int i = 39; i >= 0; --i) {
+        string name = (i < 10 ? "0" : "") + to_string(i) + (i % 7 == 0 ? ".jsonl" : ".json");
+        ofstream(root / "sub" / name) << "{\"n\":" << i << "}";
+    }
+    for (int i = 0; i < 40; ++i) {
+        expected.push_back((root / "sub").string() + "/" + (i < 10 ? "0" : "") + to_string(i) +
+                           (i % 7 == 0 ? ".jsonl" : ".json"));
+    }
+
+    for (bool inodeOrder : {false, true}) {
+        DirectoryWalker walker(root.string(), 4);
+        FilePrefetcher prefetcher(
+            walker, [](const string& path) { return JsonRecordReader::isJsonLinesFile(path); }, 3, inodeOrder, 4);
+        vector<string> found;
+        FilePrefetcher::File file;
+        while (prefetcher.next(file)) {
+            int number = stoi(file.path.substr(file.path.size() - (file.passedThrough ? 8 : 7), 2));
+            REQUIRE(file.passedThrough == (number % 7 == 0));
+            REQUIRE(file.loaded == !file.passedThrough);
+            if (file.loaded) {
+                REQUIRE(file.content == "{\"n\":" + to_string(number) + "}");
+            }
+            found.push_back(file.path);
+            prefetcher.recycle(move(file.content));
+        }
+        // Files come back in walk order however they were read
+        REQUIRE(found == expected);
+    }
+    filesystem::remove_all(root);
+}
@@ -0,0 +1,225 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "JsonEscape.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+/**
+ * @class Benchmark
+ * @brief A small self-contained microbenchmark harness. Each benchmark runs a few untimed
+ * warmup rounds, then a fixed number of timed repetitions; the per-operation time of every
+ * repetition is kept so the report can show min, median and p99 instead of a single average.
+ * Where hardware counters are available, the timed repetitions are also counted and reported
+ * per operation, and so are heap allocations in the allocation-tracking build.
+ */
+class Benchmark {
+   public:
+    /**
+     * @struct Result
+     * @brief Timing summary of one benchmark, in nanoseconds per operation.
+     */
+    struct Result {
+        string name;
+        size_t operations;      // Operations performed by one repetition
+        int repetitions;        // Timed repetitions
+        double minNs;
+        double medianNs;
+        double p99Ns;
+        double meanNs;
+        PerfCounters::Counts perOperation;  // Hardware counts per operation over the timed repetitions
+        double allocationsPerOp;            // Heap allocations per operation (allocation-tracking build only)
+        double allocatedBytesPerOp;
+    };
+
+   private:
+    int warmupRuns;
+    int repetitions;
+    vector<Result> results;
+    PerfCounters perf;
+
+    /**
+     * @brief Returns the nearest-rank percentile of sorted samples.
+     */
+    static double percentile(const vector<double>& sorted, double fraction) {
+        size_t rank = static_cast<size_t>(ceil(fraction * sorted.size()));
+        return sorted[rank == 0 ? 0 : rank - 1];
+    }
+
+   public:
+    /**
+     * @brief Constructs a harness.
+     * @param warmup Untimed runs before measuring each benchmark.
+     * @param timedRepetitions Timed runs per benchmark.
+     */
+    explicit Benchmark(int warmup = 3, int timedRepetitions = 30)
+        : warmupRuns(warmup), repetitions(max(1, timedRepetitions)) {}
+
+    /**
+     * @brief Keeps the compiler from optimizing away a value computed by a benchmark body.
+     */
+    template <typename T>
+    static void doNotOptimize(const T& value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    /**
+     * @brief Runs a benchmark and records its result.
+     * @param name The benchmark name used in the report.
+     * @param operations Number of operations one call of `body` performs.
+     * @param body The measured code.
+     * @param setup Untimed preparation run before every call of `body`.
+     * @return The recorded result.
+     */
+    template <typename Body, typename Setup>
+    const Result& run(const string& name, size_t operations, Body body, Setup setup) {
+        for (int i = 0; i < warmupRuns; ++i) {
+            setup();
+            body();
+        }
+
+        vector<double> samples;
+        samples.reserve(repetitions);
+        PerfCounters::Counts counts;
+        AllocationTracker::Counts allocations;
+        for (int i = 0; i < repetitions; ++i) {
+            setup();
+            AllocationTracker::Counts allocationsBefore = AllocationTracker::snapshot();
+            PerfCounters::Counts before = perf.read();
+            auto start = chrono::steady_clock::now();
+            body();
+            chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+            counts.addDelta(before, perf.read());
+            AllocationTracker::Counts delta = AllocationTracker::snapshot().since(allocationsBefore);
+            allocations.allocations[AllocationTracker::OTHER] += delta.totalAllocations();
+            allocations.bytes[AllocationTracker::OTHER] += delta.totalBytes();
+            samples.push_back(elapsed.count() / max<size_t>(1, operations));
+        }
+        sort(samples.begin(), samples.end());
+        double totalOperations = static_cast<double>(max<size_t>(1, operations)) * repetitions;
+        for (double& value : counts.values) {
+            value /= totalOperations;
+        }
+
+        double total = 0;
+        for (double sample : samples) {
+            total += sample;
+        }
+        results.push_back({name, operations, repetitions, samples.front(), percentile(samples, 0.5),
+                           percentile(samples, 0.99), total / samples.size(), counts,
+                           allocations.totalAllocations() / totalOperations, allocations.totalBytes() / totalOperations});
+        return results.back();
+    }
+
+    /**
+     * @brief Runs a benchmark that needs no per-repetition setup.
+     */
+    template <typename Body>
+    const Result& run(const string& name, size_t operations, Body body) {
+        return run(name, operations, body, [] {});
+    }
+
+    /**
+     * @brief Returns every result recorded so far.
+     */
+    const vector<Result>& getResults() const {
+        return results;
+    }
+
+    /**
+     * @brief Returns true if the harness itself was compiled with optimizations, which
+     *        timings are only meaningful with.
+     */
+    static bool isOptimizedBuild() {
+#ifdef __OPTIMIZE__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Prints the results as an aligned table.
+     */
+    void printTable(ostream& out) const {
+        out << left << setw(28) << "benchmark" << right << setw(10) << "ops" << setw(12) << "min ns/op" << setw(12)
+            << "median" << setw(12) << "p99" << "\n";
+        for (const auto& result : results) {
+            out << left << setw(28) << result.name << right << setw(10) << result.operations << fixed
+                << setprecision(1) << setw(12) << result.minNs << setw(12) << result.medianNs << setw(12)
+                << result.p99Ns << "\n";
+        }
+        if (perf.isAvailable()) {
+            out << left << setw(28) << "per op" << right;
+            for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+                out << setw(15) << PerfCounters::eventName(static_cast<PerfCounters::Event>(event));
+            }
+            out << setw(7) << "IPC" << "\n";
+            for (const auto& result : results) {
+                out << left << setw(28) << result.name << right;
+                for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+                    if (result.perOperation.available[event]) {
+                        out << setw(15) << result.perOperation.values[event];
+                    } else {
+                        out << setw(15) << "n/a";
+                    }
+                }
+                out << setw(7) << setprecision(2) << result.perOperation.instructionsPerCycle() << setprecision(1)
+                    << "\n";
+            }
+        } else {
+            out << "Hardware counters unavailable (" << perf.getUnavailableReason() << ").\n";
+        }
+        if (AllocationTracker::isEnabled()) {
+            out << left << setw(28) << "per op" << right << setw(14) << "allocations" << setw(14) << "bytes" << "\n";
+            for (const auto& result : results) {
+                out << left << setw(28) << result.name << right << setprecision(2) << setw(14)
+                    << result.allocationsPerOp << setw(14) << result.allocatedBytesPerOp << "\n";
+            }
+        }
+        out.unsetf(ios::floatfield);
+        if (!isOptimizedBuild()) {
+            out << "Warning: built without optimizations; configure with -DCMAKE_BUILD_TYPE=Release.\n";
+        }
+    }
+
+    /**
+     * @brief Writes the results as JSON so runs from different commits can be compared.
+     */
+    void writeJson(ostream& out) const {
+        out << "{\n  \"optimized\": " << (isOptimizedBuild() ? "true" : "false") << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << JsonEscape::escape(result.name)
+                << "\", \"operations\": " << result.operations << ", \"repetitions\": " << result.repetitions
+                << ", \"min_ns_per_op\": " << result.minNs << ", \"median_ns_per_op\": " << result.medianNs
+                << ", \"p99_ns_per_op\": " << result.p99Ns << ", \"mean_ns_per_op\": " << result.meanNs;
+            for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+                out << ", \"" << PerfCounters::eventName(static_cast<PerfCounters::Event>(event)) << "_per_op\": ";
+                if (result.perOperation.available[event]) {
+                    out << result.perOperation.values[event];
+                } else {
+                    out << "null";
+                }
+            }
+            if (AllocationTracker::isEnabled()) {
+                out << ", \"allocations_per_op\": " << result.allocationsPerOp
+                    << ", \"allocated_bytes_per_op\": " << result.allocatedBytesPerOp;
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+#endif  // BENCHMARK_H
@@ -0,0 +1,190 @@
+#ifndef CHAMPION_LISTS_H
+#define CHAMPION_LISTS_H
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AvlTree.h"
+#include "DocumentTable.h"
+
+using namespace std;
+
+/**
+ * @class ChampionLists
+ * @brief Precomputed "champion" documents for common terms: the documents with the highest
+ * ranking score for the term alone, plus the best score among the documents left out.
+ * Short queries can then be ranked from a few champions instead of whole posting lists,
+ * and the stored bound tells whether the champions are enough to guarantee the top results.
+ */
+class ChampionLists {
+   public:
+    /**
+     * @struct ChampionList
+     * @brief The champions of one term and the best score of any document not in the list.
+     */
+    struct ChampionList {
+        vector<pair<string, int>> champions;    // (document, frequency), best score first
+        double bestOtherScore = 0;              // Highest score among the term's non-champion documents
+    };
+
+   private:
+    // Champion lists keyed by term; terms with short posting lists have no entry
+    unordered_map<string, ChampionList> lists;
+
+    // Number of champions kept per term
+    size_t listSize = 0;
+
+   public:
+    /**
+     * @brief Scores one posting the same way the query processor ranks single-term results.
+     * @param documents The document table holding the static scores.
+     * @param documentName The document of the posting.
+     * @param frequency The term frequency in that document.
+     * @param staticWeight The weight of the static quality prior.
+     */
+    static double score(const DocumentTable& documents, const string& documentName, int frequency,
+                        double staticWeight) {
+        int docID = documents.getID(documentName);
+        double staticScore = docID >= 0 ? documents.getStaticScore(docID) : 0.0;
+        return frequency * (1.0 + staticWeight * staticScore);
+    }
+
+    /**
+     * @brief Builds champion lists for every term whose posting list is longer than the list size.
+     * @param words The words tree.
+     * @param documents The document table holding the static scores.
+     * @param championsPerTerm Number of champions kept per term.
+     * @param staticWeight The weight of the static quality prior used in ranking.
+     */
+    void build(const AvlTree<string>& words, const DocumentTable& documents, size_t championsPerTerm,
+               double staticWeight) {
+        lists.clear();
+        listSize = championsPerTerm;
+        vector<pair<double, const pair<const string, int>*>> scored;
+        words.forEachNode([&](const string& key, const map<string, int>& wordMap) {
+            if (wordMap.size() <= championsPerTerm) {
+                return;
+            }
+            scored.clear();
+            for (const auto& posting : wordMap) {
+                scored.emplace_back(score(documents, posting.first, posting.second, staticWeight), &posting);
+            }
+            auto byScore = [](const pair<double, const pair<const string, int>*>& a,
+                              const pair<double, const pair<const string, int>*>& b) { return a.first > b.first; };
+            nth_element(scored.begin(), scored.begin() + championsPerTerm, scored.end(), byScore);
+            sort(scored.begin(), scored.begin() + championsPerTerm, byScore);
+
+            ChampionList& list = lists[key];
+            for (size_t i = 0; i < championsPerTerm; ++i) {
+                list.champions.emplace_back(scored[i].second->first, scored[i].second->second);
+            }
+            list.bestOtherScore = scored[championsPerTerm].first;
+        });
+    }
+
+    /**
+     * @brief Returns the champion list of a term, or nullptr if the term's whole posting list is short.
+     */
+    const ChampionList* find(const string& term) const {
+        auto found = lists.find(term);
+        return found == lists.end() ? nullptr : &found->second;
+    }
+
+    /**
+     * @brief Returns the number of champions kept per term.
+     */
+    size_t getListSize() const {
+        return listSize;
+    }
+
+    /**
+     * @brief Returns the number of terms with a champion list.
+     */
+    size_t getSize() const {
+        return lists.size();
+    }
+
+    /**
+     * @brief Writes the lists as "term:bestOtherScore:(length:doc,freq)(length:doc,freq)..." lines,
+     *        after a first line holding the list size. Each document path is prefixed with its
+     *        length, so paths containing ',', ')' or ':' read back intact.
+     * @param filename The name of the file to write to.
+     */
+    void writeToTextFile(const string& filename) const {
+        ofstream outFile(filename);
+        if (!outFile) {
+            cerr << "Error: Unable to open file " << filename << " for writing." << endl;
+            return;
+        }
+        outFile << setprecision(17) << listSize << "\n";
+        for (const auto& entry : lists) {
+            outFile << entry.first << ":" << entry.second.bestOtherScore << ":";
+            for (const auto& champion : entry.second.champions) {
+                outFile << "(" << champion.first.size() << ":" << champion.first << "," << champion.second << ")";
+            }
+            outFile << "\n";
+        }
+        outFile.close();
+    }
+
+    /**
+     * @brief Reads lists written by writeToTextFile, replacing the current contents.
+     * @param filename The name of the file to read from.
+     */
+    void readFromTextFile(const string& filename) {
+        ifstream inFile(filename);
+        if (!inFile) {
+            cerr << "Error: Unable to open file " << filename << " for reading." << endl;
+            return;
+        }
+
+        lists.clear();
+        string line;
+        if (getline(inFile, line)) {
+            listSize = stoul(line);
+        }
+        while (getline(inFile, line)) {
+            size_t termEnd = line.find(':');
+            size_t boundEnd = termEnd == string::npos ? string::npos : line.find(':', termEnd + 1);
+            if (boundEnd == string::npos) {
+                cerr << "Error: Invalid file format. Colon not found." << endl;
+                continue;
+            }
+            ChampionList& list = lists[line.substr(0, termEnd)];
+            list.bestOtherScore = stod(line.substr(termEnd + 1, boundEnd - termEnd - 1));
+
+            // Each champion is "(length:doc,freq)"; the path is taken by length, never searched for delimiters
+            size_t pos = boundEnd + 1;
+            while (pos < line.size() && line[pos] == '(') {
+                size_t lengthEnd = line.find(':', pos);
+                size_t nameStart = lengthEnd + 1;
+                size_t nameLength = 0;
+                bool valid = lengthEnd != string::npos && lengthEnd > pos + 1 &&
+                             all_of(line.begin() + pos + 1, line.begin() + lengthEnd, ::isdigit);
+                if (valid) {
+                    nameLength = stoul(line.substr(pos + 1, lengthEnd - pos - 1));
+                    valid = nameStart + nameLength < line.size() && line[nameStart + nameLength] == ',';
+                }
+                size_t closeParenPos = valid ? line.find(')', nameStart + nameLength) : string::npos;
+                if (closeParenPos == string::npos) {
+                    cerr << "Error: Invalid file format. Malformed champion entry." << endl;
+                    break;
+                }
+                list.champions.emplace_back(line.substr(nameStart, nameLength),
+                                            stoi(line.substr(nameStart + nameLength + 1,
+                                                             closeParenPos - nameStart - nameLength - 1)));
+                pos = closeParenPos + 1;
+            }
+        }
+        inFile.close();
+    }
+};
+
+#endif  // CHAMPION_LISTS_H
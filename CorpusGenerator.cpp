@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "rapidjson/stringbuffer.h"  // For building each article in memory
+#include "rapidjson/writer.h"        // For writing JSON
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * @class CorpusGenerator
+ * @brief Generates synthetic news articles in the schema of the sample data, for indexing
+ * and query benchmarks at scales the sample data cannot reach. Words follow a Zipf
+ * distribution, article lengths are log-normal, and every article belongs to a topic that
+ * biases its vocabulary and brings along that topic's people and organizations, so entities
+ * co-occur the way they do in real news. The output depends only on the seed and the options.
+ */
+class CorpusGenerator {
+   public:
+    /**
+     * @struct Options
+     * @brief Size and shape of the generated corpus.
+     */
+    struct Options {
+        uint64_t seed = 42;
+        size_t vocabularySize = 50000;      // Distinct content words
+        double zipfExponent = 1.07;         // Exponent of the word-rank distribution
+        size_t numTopics = 500;             // Topics, each with its own words and entities
+        size_t numPersons = 20000;
+        size_t numOrganizations = 5000;
+        size_t numSites = 300;
+        double medianLength = 400;          // Median article length in words
+        double lengthSigma = 0.6;           // Log-normal spread of article lengths
+        size_t filesPerDirectory = 10000;
+    };
+
+   private:
+    /**
+     * @struct Topic
+     * @brief Words and entities that articles about one topic tend to share.
+     */
+    struct Topic {
+        vector<size_t> words;
+        vector<size_t> persons;
+        vector<size_t> organizations;
+    };
+
+    // Function words that take the most frequent ranks, as in real English text
+    static const vector<string>& functionWords() {
+        static const vector<string> words = {
+            "the", "of", "to", "and", "a", "in", "that", "is", "for", "on", "it", "with", "as", "was", "he",
+            "said", "by", "at", "be", "from", "has", "have", "are", "an", "his", "its", "but", "not", "they",
+            "were", "this", "which", "will", "who", "been", "would", "their", "had", "after", "more", "also",
+            "than", "about", "one", "new", "up", "or", "she", "we", "over", "last", "two", "year", "her"};
+        return words;
+    }
+
+    Options options;
+    uint64_t state;
+
+    vector<string> vocabulary;
+    vector<double> wordCdf;
+    vector<string> persons;
+    vector<double> personCdf;
+    vector<string> organizations;
+    vector<double> organizationCdf;
+    vector<string> sites;
+    vector<double> siteCdf;
+    vector<string> authors;
+    vector<Topic> topics;
+    vector<double> topicCdf;
+
+    /**
+     * @brief Returns the next pseudo-random 64-bit value (xorshift64*), identical on every platform.
+     */
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dULL;
+    }
+
+    /**
+     * @brief Returns a uniform double in [0, 1).
+     */
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /**
+     * @brief Returns a uniform integer in [0, bound).
+     */
+    size_t below(size_t bound) {
+        return static_cast<size_t>(uniform() * bound);
+    }
+
+    /**
+     * @brief Returns a standard normal value (Box-Muller).
+     */
+    double normal() {
+        double u = 1.0 - uniform();
+        return sqrt(-2.0 * log(u)) * cos(2.0 * acos(-1.0) * uniform());
+    }
+
+    /**
+     * @brief Builds the cumulative distribution of a Zipf law over `size` ranks.
+     */
+    static vector<double> zipfCdf(size_t size, double exponent) {
+        vector<double> cdf(size);
+        double total = 0;
+        for (size_t rank = 0; rank < size; ++rank) {
+            total += 1.0 / pow(rank + 1.0, exponent);
+            cdf[rank] = total;
+        }
+        for (double& value : cdf) {
+            value /= total;
+        }
+        return cdf;
+    }
+
+    /**
+     * @brief Draws a rank from a cumulative distribution.
+     */
+    size_t sample(const vector<double>& cdf) {
+        size_t rank = upper_bound(cdf.begin(), cdf.end(), uniform()) - cdf.begin();
+        return min(rank, cdf.size() - 1);
+    }
+
+    /**
+     * @brief Makes a pronounceable lowercase word of a few syllables.
+     */
+    string makeWord(size_t syllables) {
+        static const char* const onsets[] = {"b", "c", "d", "f", "g", "h", "j", "k", "l", "m", "n", "p", "r",
+                                             "s", "t", "v", "w", "z", "br", "ch", "cr", "dr", "gr", "pl",
+                                             "pr", "sh", "st", "th", "tr"};
+        static const char* const vowels[] = {"a", "e", "i", "o", "u", "ai", "ea", "io", "ou"};
+        static const char* const codas[] = {"", "", "", "n", "r", "s", "t", "l", "nd", "st"};
+        string word;
+        for (size_t i = 0; i < syllables; ++i) {
+            word += onsets[below(sizeof(onsets) / sizeof(*onsets))];
+            word += vowels[below(sizeof(vowels) / sizeof(*vowels))];
+        }
+        return word + codas[below(sizeof(codas) / sizeof(*codas))];
+    }
+
+    /**
+     * @brief Capitalizes the first letter of a word.
+     */
+    static string capitalize(string word) {
+        if (!word.empty()) {
+            word[0] = static_cast<char>(toupper(word[0]));
+        }
+        return word;
+    }
+
+    /**
+     * @brief Formats a 40-digit hexadecimal identifier like the sample data's uuids.
+     */
+    string makeUuid() {
+        static const char* const digits = "0123456789abcdef";
+        string uuid;
+        for (int i = 0; i < 40; ++i) {
+            uuid += digits[below(16)];
+        }
+        return uuid;
+    }
+
+    /**
+     * @brief Formats a timestamp in 2018 as "YYYY-MM-DDThh:mm:ss.000+00:00".
+     */
+    string makePublished() {
+        static const int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        int day = static_cast<int>(below(365));
+        int month = 0;
+        while (day >= daysInMonth[month]) {
+            day -= daysInMonth[month++];
+        }
+        char buffer[80];  // Room for any int fields, though each is at most two digits
+        snprintf(buffer, sizeof(buffer), "2018-%02d-%02dT%02d:%02d:%02d.000+00:00", month + 1, day + 1,
+                 static_cast<int>(below(24)), static_cast<int>(below(60)), static_cast<int>(below(60)));
+        return buffer;
+    }
+
+    /**
+     * @brief Draws a content word, favoring the article's topic words.
+     */
+    const string& drawWord(const Topic& topic) {
+        if (uniform() < 0.15) {
+            return vocabulary[topic.words[below(topic.words.size())]];
+        }
+        return vocabulary[sample(wordCdf)];
+    }
+
+   public:
+    /**
+     * @brief Builds the vocabulary, entity pools and topics for a seed.
+     */
+    explicit CorpusGenerator(const Options& generatorOptions)
+        : options(generatorOptions), state(generatorOptions.seed * 0x9e3779b97f4a7c15ULL + 1) {
+        vocabulary = functionWords();
+        unordered_set<string> seen(vocabulary.begin(), vocabulary.end());
+        while (vocabulary.size() < options.vocabularySize) {
+            string word = makeWord(1 + below(3));
+            if (seen.insert(word).second) {
+                vocabulary.push_back(word);
+            }
+        }
+        wordCdf = zipfCdf(vocabulary.size(), options.zipfExponent);
+
+        for (size_t i = 0; i < options.numPersons; ++i) {
+            persons.push_back(makeWord(1 + below(2)) + " " + makeWord(2));
+        }
+        personCdf = zipfCdf(persons.size(), 1.0);
+        for (size_t i = 0; i < options.numOrganizations; ++i) {
+            organizations.push_back(makeWord(2) + (uniform() < 0.3 ? " " + makeWord(1) : ""));
+        }
+        organizationCdf = zipfCdf(organizations.size(), 1.0);
+        for (size_t i = 0; i < options.numSites; ++i) {
+            sites.push_back(makeWord(2) + (i % 3 == 0 ? ".com" : i % 3 == 1 ? ".net" : ".org"));
+            authors.push_back(capitalize(makeWord(1)) + " " + capitalize(makeWord(2)));
+        }
+        siteCdf = zipfCdf(sites.size(), 1.0);
+
+        // Topics draw their words from the middle of the vocabulary and their entities from the pools
+        size_t firstTopicWord = min(vocabulary.size() - 1, functionWords().size() + 200);
+        for (size_t i = 0; i < options.numTopics; ++i) {
+            Topic topic;
+            for (int j = 0; j < 40; ++j) {
+                topic.words.push_back(firstTopicWord + below(vocabulary.size() - firstTopicWord));
+            }
+            for (int j = 0; j < 6; ++j) {
+                topic.persons.push_back(sample(personCdf));
+                topic.organizations.push_back(sample(organizationCdf));
+            }
+            topics.push_back(topic);
+        }
+        topicCdf = zipfCdf(topics.size(), 0.8);
+    }
+
+    /**
+     * @brief Generates one article as a JSON string.
+     * @param index The article's position in the corpus, used in its URL.
+     */
+    string makeArticle(size_t index) {
+        const Topic& topic = topics[sample(topicCdf)];
+
+        // Entities mostly come from the topic, sometimes from anywhere
+        vector<string> articlePersons, articleOrganizations;
+        for (size_t count = below(4); articlePersons.size() < count;) {
+            const string& person =
+                uniform() < 0.8 ? persons[topic.persons[below(topic.persons.size())]] : persons[sample(personCdf)];
+            if (find(articlePersons.begin(), articlePersons.end(), person) == articlePersons.end()) {
+                articlePersons.push_back(person);
+            } else {
+                --count;
+            }
+        }
+        for (size_t count = 1 + below(3); articleOrganizations.size() < count;) {
+            const string& organization = uniform() < 0.8 ? organizations[topic.organizations[below(topic.organizations.size())]]
+                                                        : organizations[sample(organizationCdf)];
+            if (find(articleOrganizations.begin(), articleOrganizations.end(), organization) ==
+                articleOrganizations.end()) {
+                articleOrganizations.push_back(organization);
+            } else {
+                --count;
+            }
+        }
+
+        // Body text of sentences whose words follow the Zipf law, mentioning the entities
+        double length = exp(log(options.medianLength) + options.lengthSigma * normal());
+        size_t numWords = static_cast<size_t>(max(30.0, min(5000.0, length)));
+        string text;
+        size_t sentenceLeft = 0;
+        for (size_t i = 0; i < numWords; ++i) {
+            bool startSentence = sentenceLeft == 0;
+            if (startSentence) {
+                sentenceLeft = 8 + below(18);
+            }
+            string word;
+            double entityChance = uniform();
+            if (entityChance < 0.01 && !articlePersons.empty()) {
+                word = articlePersons[below(articlePersons.size())];
+            } else if (entityChance < 0.02) {
+                word = articleOrganizations[below(articleOrganizations.size())];
+            } else {
+                word = drawWord(topic);
+            }
+            text += startSentence ? capitalize(word) : word;
+            text += --sentenceLeft == 0 || i + 1 == numWords ? ". " : uniform() < 0.06 ? ", " : " ";
+        }
+        text.pop_back();
+
+        string title;
+        for (size_t i = 0, words = 5 + below(8); i < words; ++i) {
+            title += (i == 0 ? "" : " ") + capitalize(drawWord(topic));
+        }
+        size_t site = sample(siteCdf);
+        string url = "https://www." + sites[site] + "/article/" + to_string(index);
+        string published = makePublished();
+        string uuid = makeUuid();
+        double spamScore = uniform() < 0.9 ? 0.0 : round(uniform() * 1000) / 1000;
+
+        StringBuffer buffer;
+        Writer<StringBuffer> writer(buffer);
+        auto writeEntities = [&](const vector<string>& names) {
+            writer.StartArray();
+            for (const auto& name : names) {
+                writer.StartObject();
+                writer.Key("name");
+                writer.String(name.c_str());
+                writer.Key("sentiment");
+                writer.String("none");
+                writer.EndObject();
+            }
+            writer.EndArray();
+        };
+
+        writer.StartObject();
+        writer.Key("organizations");
+        writer.StartArray();
+        writer.EndArray();
+        writer.Key("uuid");
+        writer.String(uuid.c_str());
+        writer.Key("thread");
+        writer.StartObject();
+        writer.Key("site_full");
+        writer.String(("www." + sites[site]).c_str());
+        writer.Key("url");
+        writer.String(url.c_str());
+        writer.Key("country");
+        writer.String("US");
+        writer.Key("domain_rank");
+        writer.Int64(static_cast<int64_t>(1 + site * site + below(50)));
+        writer.Key("title");
+        writer.String(title.c_str());
+        writer.Key("site");
+        writer.String(sites[site].c_str());
+        writer.Key("spam_score");
+        writer.Double(spamScore);
+        writer.Key("site_type");
+        writer.String("news");
+        writer.Key("published");
+        writer.String(published.c_str());
+        writer.Key("uuid");
+        writer.String(uuid.c_str());
+        writer.EndObject();
+        writer.Key("author");
+        writer.String(authors[site].c_str());
+        writer.Key("url");
+        writer.String(url.c_str());
+        writer.Key("ord_in_thread");
+        writer.Int(0);
+        writer.Key("title");
+        writer.String(title.c_str());
+        writer.Key("locations");
+        writer.StartArray();
+        writer.EndArray();
+        writer.Key("entities");
+        writer.StartObject();
+        writer.Key("persons");
+        writeEntities(articlePersons);
+        writer.Key("locations");
+        writeEntities({});
+        writer.Key("organizations");
+        writeEntities(articleOrganizations);
+        writer.EndObject();
+        writer.Key("highlightText");
+        writer.String("");
+        writer.Key("language");
+        writer.String("english");
+        writer.Key("persons");
+        writer.StartArray();
+        writer.EndArray();
+        writer.Key("text");
+        writer.String(text.c_str());
+        writer.Key("external_links");
+        writer.StartArray();
+        writer.EndArray();
+        writer.Key("published");
+        writer.String(published.c_str());
+        writer.Key("crawled");
+        writer.String(published.c_str());
+        writer.Key("highlightTitle");
+        writer.String("");
+        writer.EndObject();
+        return buffer.GetString();
+    }
+
+    /**
+     * @brief Writes `count` articles under `directory`, `filesPerDirectory` per subdirectory.
+     * @return True if every file was written.
+     */
+    bool writeCorpus(const string& directory, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            char folder[32], file[32];
+            snprintf(folder, sizeof(folder), "coll_%05zu", i / options.filesPerDirectory);
+            snprintf(file, sizeof(file), "news_%09zu.json", i);
+            filesystem::path path = filesystem::path(directory) / folder;
+            if (i % options.filesPerDirectory == 0) {
+                filesystem::create_directories(path);
+            }
+            ofstream output(path / file);
+            if (!output) {
+                cerr << "Error: Unable to open file " << (path / file).string() << " for writing." << endl;
+                return false;
+            }
+            output << makeArticle(i);
+            if ((i + 1) % 100000 == 0) {
+                cout << "Generated " << i + 1 << " articles\n";
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage:\n"
+             << argv[0] << " <output-directory> <num-articles> [--seed=<n>] [--vocabulary=<words>]\n"
+             << "      [--median-length=<words>] [--files-per-directory=<n>]\n";
+        return 1;
+    }
+
+    CorpusGenerator::Options options;
+    for (int i = 3; i < argc; ++i) {
+        string option = argv[i];
+        string value = option.substr(option.find('=') + 1);
+        if (option.rfind("--seed=", 0) == 0) {
+            options.seed = stoull(value);
+        } else if (option.rfind("--vocabulary=", 0) == 0) {
+            options.vocabularySize = stoul(value);
+        } else if (option.rfind("--median-length=", 0) == 0) {
+            options.medianLength = stod(value);
+        } else if (option.rfind("--files-per-directory=", 0) == 0) {
+            options.filesPerDirectory = max<size_t>(1, stoul(value));
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 1;
+        }
+    }
+
+    CorpusGenerator generator(options);
+    size_t count = stoul(argv[2]);
+    if (!generator.writeCorpus(argv[1], count)) {
+        return 1;
+    }
+    cout << "Generated " << count << " articles in " << argv[1] << "\n";
+    return 0;
+}
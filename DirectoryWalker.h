@@ -0,0 +1,409 @@
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * @class DirectoryWalker
+ * @brief Enumerates the regular files under a directory on several threads and hands them out
+ * as they are found, so indexing starts with the first file instead of after a full listing.
+ * On Linux, each walker thread reads whole directories with getdents64 into a 64 KiB buffer and
+ * opens subdirectories with openat relative to their parent, and the entry type in the
+ * directory record replaces a stat per entry; only file systems that do not report types, and
+ * symbolic links, cost an fstatat. Like recursive_directory_iterator, links to files are
+ * returned and links to directories are not followed. Files are returned in a fixed order,
+ * whatever the thread count and timing: depth first, with each directory's entries sorted by
+ * name in byte order. Walkers read directories ahead of the consumer, deepest pending first,
+ * which follows that order and keeps few parent directories open. They stop taking new
+ * directories while a queue's worth of listed files waits to be returned, except for the one
+ * directory the consumer is waiting on. Each file comes with the inode number from its
+ * directory record, so readers can order reads by it. Elsewhere, directories are listed with
+ * directory_iterator and inode numbers are 0.
+ */
+class DirectoryWalker {
+   public:
+    // Walker threads; directory reads mostly wait on the file system, so more threads than cores can help
+    static constexpr size_t DEFAULT_THREADS = 4;
+
+    // Listed files that may wait for the consumer before walker threads stop reading ahead
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 4096;
+
+    /**
+     * @struct FoundFile
+     * @brief A regular file and its inode number (of the link, for symbolic links).
+     */
+    struct FoundFile {
+        string path;
+        uint64_t inode;
+    };
+
+   private:
+    /**
+     * @struct DirectoryHandle
+     * @brief An open directory, closed once it is read and every subdirectory opened from it.
+     */
+    struct DirectoryHandle {
+        int fd;
+
+        explicit DirectoryHandle(int descriptor) : fd(descriptor) {}
+
+        ~DirectoryHandle() {
+#ifdef __linux__
+            close(fd);
+#endif
+        }
+    };
+
+    struct DirectoryNode;
+
+    /**
+     * @struct Entry
+     * @brief A file, or a subdirectory (`directory` set), of a listed directory.
+     */
+    struct Entry {
+        FoundFile file;
+        shared_ptr<DirectoryNode> directory;
+
+        // Entries of one directory share its path as a prefix, so paths sort as names do
+        const string& path() const {
+            return directory != nullptr ? directory->path : file.path;
+        }
+    };
+
+    /**
+     * @struct DirectoryNode
+     * @brief A directory of the walk. A walker lists it and sets `listed`; the consumer then
+     *        returns its entries in order, descending into each subdirectory as it comes.
+     */
+    struct DirectoryNode {
+        shared_ptr<DirectoryHandle> parent;  // Opened relative to it; nullptr for the root
+        string name;
+        string path;
+        bool claimed = false;       // A walker took it from the pending stack
+        atomic<bool> listed{false};  // Set once `entries` is filled; the consumer then reads them without the lock
+        vector<Entry> entries;      // Sorted by name
+    };
+
+    /**
+     * @struct Position
+     * @brief The consumer's place in one directory of the current path from the root.
+     */
+    struct Position {
+        shared_ptr<DirectoryNode> node;
+        size_t next;
+    };
+
+    mutex lock;
+    condition_variable workAvailable;  // A directory was queued, the consumer needs one, or room was made
+    condition_variable listedAvailable;  // A directory was listed, or the walk finished
+    vector<shared_ptr<DirectoryNode>> directories;  // Pending, the next in walk order on top
+    shared_ptr<DirectoryNode> wanted;               // The directory the consumer is waiting on
+    vector<Position> cursor;                        // Consumer only
+    size_t returnedUnsettled = 0;                   // Consumer only: returned but not yet taken off filesAhead
+    size_t capacity;
+    size_t filesAhead = 0;  // Listed files not yet returned
+    size_t busyWalkers = 0;
+    bool finished = false;
+    bool stopping = false;
+    atomic<size_t> directoriesRead{0};
+    atomic<size_t> filesFound{0};
+    atomic<size_t> statCalls{0};
+    vector<thread> walkers;
+
+#ifdef __linux__
+    /**
+     * @struct DirectoryRecordHeader
+     * @brief The fixed part of a linux_dirent64 record; the file name follows d_type.
+     */
+    struct DirectoryRecordHeader {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+    };
+#endif
+
+    /**
+     * @brief Lists one directory's files and subdirectories, unsorted.
+     */
+    void listDirectory(DirectoryNode& directory, vector<Entry>& entries) {
+#ifdef __linux__
+        int fd = directory.parent != nullptr
+                     ? openat(directory.parent->fd, directory.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+                     : open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            cerr << "Cannot open directory: " << directory.path << " (" << strerror(errno) << ")" << endl;
+            return;
+        }
+        auto handle = make_shared<DirectoryHandle>(fd);
+        directoriesRead++;
+
+        alignas(8) char buffer[64 << 10];
+        while (true) {
+            long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+            if (bytes < 0) {
+                cerr << "Cannot read directory: " << directory.path << " (" << strerror(errno) << ")" << endl;
+            }
+            if (bytes <= 0) {
+                break;
+            }
+            for (long position = 0; position < bytes;) {
+                const DirectoryRecordHeader* record = reinterpret_cast<const DirectoryRecordHeader*>(buffer + position);
+                const char* name = buffer + position + offsetof(DirectoryRecordHeader, d_type) + 1;
+                position += record->d_reclen;
+                if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                    continue;
+                }
+                unsigned char type = record->d_type;
+                if (type == DT_UNKNOWN || type == DT_LNK) {
+                    // Links are followed to see whether they name a file, but never walked into
+                    struct stat status;
+                    statCalls++;
+                    if (fstatat(fd, name, &status, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+                        continue;
+                    }
+                    bool link = type == DT_LNK;
+                    type = S_ISREG(status.st_mode) ? DT_REG : S_ISDIR(status.st_mode) && !link ? DT_DIR : DT_UNKNOWN;
+                }
+                string path = directory.path + "/" + name;
+                if (type == DT_DIR) {
+                    auto subdirectory = make_shared<DirectoryNode>();
+                    subdirectory->parent = handle;
+                    subdirectory->name = name;
+                    subdirectory->path = move(path);
+                    entries.push_back({FoundFile(), move(subdirectory)});
+                } else if (type == DT_REG) {
+                    entries.push_back({{move(path), record->d_ino}, nullptr});
+                }
+            }
+        }
+#else
+        error_code error;
+        filesystem::directory_iterator iterator(directory.path, error);
+        if (error) {
+            cerr << "Cannot open directory: " << directory.path << " (" << error.message() << ")" << endl;
+            return;
+        }
+        directoriesRead++;
+        for (const auto& item : iterator) {
+            string name = item.path().filename().string();
+            if (item.is_directory(error) && !item.is_symlink(error)) {
+                auto subdirectory = make_shared<DirectoryNode>();
+                subdirectory->name = name;
+                subdirectory->path = directory.path + "/" + name;
+                entries.push_back({FoundFile(), move(subdirectory)});
+            } else if (item.is_regular_file(error)) {
+                entries.push_back({{directory.path + "/" + name, 0}, nullptr});
+            }
+        }
+#endif
+    }
+
+    /**
+     * @brief Takes the files the consumer returned off the read-ahead count; call it under the lock.
+     */
+    void settleReturned() {
+        bool wasFull = filesAhead >= capacity;
+        filesAhead -= returnedUnsettled;
+        returnedUnsettled = 0;
+        if (wasFull && filesAhead < capacity) {
+            workAvailable.notify_all();  // Back under the read-ahead limit
+        }
+    }
+
+    /**
+     * @brief Returns true if a walker may take a pending directory now.
+     */
+    bool canTakeWork() const {
+        return !directories.empty() && (filesAhead < capacity || (wanted != nullptr && !wanted->claimed));
+    }
+
+    /**
+     * @brief A walker thread: lists pending directories until none are left and no walker can add more.
+     */
+    void walk() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            workAvailable.wait(guard, [this] {
+                return stopping || canTakeWork() || (directories.empty() && busyWalkers == 0);
+            });
+            if (stopping) {
+                return;
+            }
+            if (directories.empty()) {
+                finished = true;
+                listedAvailable.notify_all();
+                workAvailable.notify_all();
+                return;
+            }
+            // The directory the consumer waits on comes first, even past the read-ahead limit
+            auto pending = directories.end() - 1;
+            if (wanted != nullptr && !wanted->claimed) {
+                pending = find(directories.begin(), directories.end(), wanted);
+            }
+            shared_ptr<DirectoryNode> directory = move(*pending);
+            directories.erase(pending);
+            directory->claimed = true;
+            ++busyWalkers;
+            guard.unlock();
+
+            vector<Entry> entries;
+            listDirectory(*directory, entries);
+            sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.path() < b.path(); });
+            size_t fileCount = 0;
+            vector<shared_ptr<DirectoryNode>> subdirectories;
+            for (const auto& entry : entries) {
+                if (entry.directory != nullptr) {
+                    subdirectories.push_back(entry.directory);
+                } else {
+                    ++fileCount;
+                }
+            }
+            filesFound += fileCount;
+            directory->parent.reset();  // Close the parent once its last subdirectory is open
+
+            guard.lock();
+            directory->entries = move(entries);
+            directory->listed.store(true, memory_order_release);
+            filesAhead += fileCount;
+            // Pushed last first, so the first subdirectory in walk order is on top
+            for (auto subdirectory = subdirectories.rbegin(); subdirectory != subdirectories.rend(); ++subdirectory) {
+                directories.push_back(move(*subdirectory));
+            }
+            --busyWalkers;
+            listedAvailable.notify_all();
+            workAvailable.notify_all();
+        }
+    }
+
+   public:
+    /**
+     * @brief Starts walking `root` in the background.
+     * @param root The directory to enumerate.
+     * @param threads Walker threads; 0 is treated as 1.
+     * @param queueCapacity Listed files that may wait before the walkers stop reading ahead.
+     */
+    DirectoryWalker(const string& root, size_t threads, size_t queueCapacity = DEFAULT_QUEUE_CAPACITY)
+        : capacity(max<size_t>(1, queueCapacity)) {
+        auto node = make_shared<DirectoryNode>();
+        node->path = root.size() > 1 && root.back() == '/' ? root.substr(0, root.size() - 1) : root;
+        node->name = node->path;
+        directories.push_back(node);
+        cursor.push_back({node, 0});
+        for (size_t walker = 0; walker < max<size_t>(1, threads); ++walker) {
+            walkers.emplace_back(&DirectoryWalker::walk, this);
+        }
+    }
+
+    /**
+     * @brief Stops the walk early if the consumer did not drain it, and waits for the threads.
+     */
+    ~DirectoryWalker() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto& walker : walkers) {
+            walker.join();
+        }
+    }
+
+    DirectoryWalker(const DirectoryWalker&) = delete;
+    DirectoryWalker& operator=(const DirectoryWalker&) = delete;
+
+    /**
+     * @brief Takes the next file in walk order, waiting for the walkers to list its directory if
+     *        they have not yet. Call it from one consumer thread. A listed directory's files are
+     *        returned without locking; the walkers learn how many were taken once per directory.
+     * @param file Filled with the file's path and inode number.
+     * @return False once every file has been returned.
+     */
+    bool next(FoundFile& file) {
+        while (!cursor.empty()) {
+            Position& position = cursor.back();
+            DirectoryNode& node = *position.node;
+            if (!node.listed.load(memory_order_acquire)) {
+                unique_lock<mutex> guard(lock);
+                settleReturned();
+                wanted = position.node;
+                workAvailable.notify_all();
+                listedAvailable.wait(guard, [&node] { return node.listed.load(memory_order_relaxed); });
+                wanted = nullptr;
+            }
+            if (position.next == node.entries.size()) {
+                cursor.pop_back();  // Releases the directory once its entries are all returned
+                lock_guard<mutex> guard(lock);
+                settleReturned();
+                continue;
+            }
+            Entry& entry = node.entries[position.next++];
+            if (entry.directory != nullptr) {
+                cursor.push_back({move(entry.directory), 0});
+                continue;
+            }
+            file = move(entry.file);
+            ++returnedUnsettled;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Takes the next found file's path, as next(FoundFile&).
+     */
+    bool next(string& path) {
+        FoundFile file;
+        if (!next(file)) {
+            return false;
+        }
+        path = move(file.path);
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of directories read so far.
+     */
+    size_t getDirectoriesRead() const {
+        return directoriesRead;
+    }
+
+    /**
+     * @brief Returns the number of regular files found so far.
+     */
+    size_t getFilesFound() const {
+        return filesFound;
+    }
+
+    /**
+     * @brief Returns the number of entries whose type needed an fstatat.
+     */
+    size_t getStatCalls() const {
+        return statCalls;
+    }
+};
+
+#endif  // DIRECTORY_WALKER_H
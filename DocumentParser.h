@@ -1,19 +1,37 @@
 #ifndef DOCUMENT_PARSER_H
 #define DOCUMENT_PARSER_H
 
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "AllocationTracker.h"
 #include "AvlTree.h"
+#include "DocumentTable.h"
+#include "FilePrefetcher.h"
+#include "GzipFile.h"
+#include "GzipSeekIndex.h"
+#include "IndexingProfile.h"
+#include "JsonRecordReader.h"
+#include "NearDuplicateDetector.h"
+#include "SpimiIndexer.h"
+#include "TimePartitionedIndex.h"
+#include "Trace.h"
 #include "Porter2/porter2Stemmer.cpp" // For stemming words
 #include "rapidjson/document.h"       // For JSON parsing
-#include "rapidjson/istreamwrapper.h" // For JSON stream handling
 
 using namespace std;
 using namespace rapidjson;
@@ -30,18 +48,184 @@ class DocumentParser {
     AvlTree<string>& OrganizationTree;
     AvlTree<string>& WordsTree;
 
+    // Per-document columns shared with the query processor
+    DocumentTable& Documents;
+
+    // Optional month partitions; when set, documents are indexed into their partition's trees
+    TimePartitionedIndex* Partitions = nullptr;
+
+    // Trees that receive the tokens of the document currently being indexed
+    AvlTree<string>* targetPersonTree;
+    AvlTree<string>* targetOrganizationTree;
+    AvlTree<string>* targetWordsTree;
+
     // Counter for the number of files indexed
     int filesIndexed = 0;
 
+    // Optional index-time filters; a negative spam threshold disables spam pruning
+    double maxSpamScore = -1.0;
+    bool dedupeExact = false;
+    bool dedupeNear = false;
+    unordered_set<string> seenUuids;
+    unordered_set<uint64_t> seenContentHashes;
+    NearDuplicateDetector nearDuplicates;
+
+    // Terms promoted to stop words by pruneVocabulary, saved so queries skip them too
+    vector<string> generatedStopWords;
+
+    // Optional per-phase timers and counters; nullptr disables profiling
+    IndexingProfile* Profile = nullptr;
+
+    // Optional external-memory indexing that flushes the trees as sorted runs; nullptr keeps everything in memory
+    SpimiIndexer* Spimi = nullptr;
+    SpimiIndexer::MergeStats spimiStats;
+
+    // Threads that parse and analyze the records of JSON Lines and concatenated-JSON files
+    size_t analysisThreads = max(1u, thread::hardware_concurrency());
+
+    // Prefetched documents analyzed together while the previous batch is indexed
+    static constexpr size_t PREFETCH_BATCH_FILES = 256;
+
+    /**
+     * @brief Returns the coarser allocation phase an indexing phase belongs to.
+     */
+    static AllocationTracker::Phase allocationPhase(IndexingProfile::Phase phase) {
+        switch (phase) {
+            case IndexingProfile::READ:
+            case IndexingProfile::PARSE:
+                return AllocationTracker::PARSE;
+            case IndexingProfile::INSERT:
+                return AllocationTracker::INSERT;
+            default:
+                return AllocationTracker::ANALYZE;
+        }
+    }
+
+    /**
+     * @brief Starts timing a phase; the clock is only read while profiling or tracing.
+     *        In the allocation-tracking build, the phase's allocations are attributed to it.
+     * @param profile The calling thread's profile, or nullptr when not profiling.
+     */
+    static IndexingProfile::Mark phaseStart(IndexingProfile::Phase phase, const IndexingProfile* profile) {
+        AllocationTracker::setPhase(allocationPhase(phase));
+        if (profile != nullptr) {
+            return profile->mark();
+        }
+        IndexingProfile::Mark start;
+        if (Trace::isEnabled()) {
+            start.time = IndexingProfile::Clock::now();
+        }
+        return start;
+    }
+
+    /**
+     * @brief Adds the time since `start` to a phase while profiling, and records it as a span while tracing.
+     */
+    static void phaseEnd(IndexingProfile::Phase phase, const IndexingProfile::Mark& start, IndexingProfile* profile) {
+        AllocationTracker::setPhase(AllocationTracker::OTHER);
+        if (profile != nullptr) {
+            profile->addPhase(phase, start);
+        }
+        if (Trace::isEnabled()) {
+            Trace::complete(IndexingProfile::phaseName(phase), "index", start.time);
+        }
+    }
+
+    // Counters for documents dropped by the index-time filters
+    int spamSkipped = 0;
+    int duplicatesSkipped = 0;
+    int nearDuplicatesSkipped = 0;
+
+    // Token occurrences added to the trees and kept out of them by the filters, and the time spent filtering
+    size_t tokensIndexed = 0;
+    size_t tokensSkipped = 0;
+    double filterSeconds = 0;
+
    public:
     /**
      * @brief Constructor that initializes the AVL trees for indexing.
      * @param person Reference to the AVL tree for persons.
      * @param org Reference to the AVL tree for organizations.
      * @param word Reference to the AVL tree for general words.
+     * @param documents Reference to the table of per-document columns.
+     */
+    DocumentParser(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& word,
+                   DocumentTable& documents)
+        : PersonTree(person), OrganizationTree(org), WordsTree(word), Documents(documents),
+          targetPersonTree(&person), targetOrganizationTree(&org), targetWordsTree(&word) {}
+
+    /**
+     * @brief Enables indexing into monthly time partitions instead of the shared trees.
+     * @param partitions The partitioned index to fill, or nullptr to use the shared trees.
      */
-    DocumentParser(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& word)
-        : PersonTree(person), OrganizationTree(org), WordsTree(word) {}
+    void setPartitionedIndex(TimePartitionedIndex* partitions) {
+        Partitions = partitions;
+    }
+
+    /**
+     * @brief Skips documents whose thread.spam_score is above a threshold.
+     * @param threshold The highest spam score that is still indexed, or a negative value to disable.
+     */
+    void setSpamThreshold(double threshold) {
+        maxSpamScore = threshold;
+    }
+
+    /**
+     * @brief Skips documents whose uuid or exact text was already indexed.
+     */
+    void setExactDedupe(bool enabled) {
+        dedupeExact = enabled;
+    }
+
+    /**
+     * @brief Skips documents whose MinHash similarity to an indexed document reaches a threshold,
+     *        keeping the first document of each group as its representative.
+     * @param threshold The estimated Jaccard similarity in (0, 1], or 0 to disable.
+     */
+    void setNearDuplicateThreshold(double threshold) {
+        dedupeNear = threshold > 0;
+        nearDuplicates = NearDuplicateDetector(threshold);
+    }
+
+    /**
+     * @brief Records per-phase times and volume counters of runDocument into a profile.
+     * @param profile The profile to fill, or nullptr to disable profiling.
+     */
+    void setProfile(IndexingProfile* profile) {
+        Profile = profile;
+    }
+
+    /**
+     * @brief Indexes under a memory budget: the trees are flushed as sorted runs whenever they
+     *        reach it, and toFile merges the runs into the index files. Not combined with
+     *        partitioning or vocabulary pruning, which need the whole index in memory.
+     * @param spimi The run writer and merger, or nullptr to keep the whole index in memory.
+     */
+    void setSpimiIndexer(SpimiIndexer* spimi) {
+        Spimi = spimi;
+    }
+
+    /**
+     * @brief Sets how many threads parse and analyze the records of multi-document files.
+     * @param threads The thread count; 0 is treated as 1.
+     */
+    void setAnalysisThreads(size_t threads) {
+        analysisThreads = max<size_t>(1, threads);
+    }
+
+    /**
+     * @brief Returns true when indexing under a memory budget into sorted runs.
+     */
+    bool isIndexingToRuns() const {
+        return Spimi != nullptr;
+    }
+
+    /**
+     * @brief Returns what the last toFile merged when indexing under a memory budget.
+     */
+    const SpimiIndexer::MergeStats& getMergeStats() const {
+        return spimiStats;
+    }
 
     // Set to store stop words for filtering
     static set<string> stopWords;
@@ -143,111 +327,688 @@ class DocumentParser {
     }
 
     /**
-     * @brief Processes and indexes a document.
-     *        It filters stop words, removes punctuation, converts text to lowercase,
-     *        stems words, and adds them to AVL trees for indexing.
-     * @param documentName The path to the document file.
+     * @struct AnalyzedDocument
+     * @brief What indexing needs from one document: its signals and analyzed tokens, extracted
+     *        without touching the index or the filters' state. Records of a multi-document file
+     *        are analyzed this way on worker threads and then indexed in file order.
      */
-    void runDocument(string documentName) {
-        filesIndexed++;
-        ifstream input(documentName);
-        if (!input.is_open()) {
-            cerr << "Cannot open file: " << documentName << endl;
+    struct AnalyzedDocument {
+        string name;          // The file path, or a "file#offset" locator for a record (JsonRecordReader)
+        bool valid = false;   // False if the JSON could not be parsed or has no text
+        long long domainRank = 0;
+        double spamScore = 0.0;
+        string uuid;
+        uint64_t textHash = 0;  // Only computed for exact deduplication
+        vector<string> tokens;  // Analyzed words, stop words removed
+        long long published = DocumentTable::NO_TIMESTAMP;
+        bool hasSite = false;
+        string site;
+        bool hasAuthor = false;
+        string author;
+        vector<string> persons;  // Entity names as written in the document
+        vector<string> organizations;
+    };
+
+    /**
+     * @brief Parses a JSON document and analyzes its text: it tokenizes, removes punctuation,
+     *        converts to lowercase, stems and filters stop words. Only reads shared state, so
+     *        several threads may analyze documents at once, each with its own profile.
+     * @param json The document's JSON text.
+     * @param length The length of the JSON text.
+     * @param document Filled with the results; its name is left as set by the caller.
+     * @param profile The calling thread's profile, or nullptr when not profiling.
+     */
+    void analyzeDocument(const char* json, size_t length, AnalyzedDocument& document, IndexingProfile* profile) const {
+        auto start = phaseStart(IndexingProfile::PARSE, profile);
+        Document d;
+        d.Parse(json, length);
+        phaseEnd(IndexingProfile::PARSE, start, profile);
+        if (d.HasParseError() || !d.IsObject() || !d.HasMember("text") || !d["text"].IsString()) {
             return;
         }
+        document.valid = true;
 
-        if (stopWords.empty()) {
-            loadStopWords("stopWords.txt");
+        // Read the quality signals first, since they decide whether the document is indexed at all
+        if (d.HasMember("thread") && d["thread"].IsObject()) {
+            const auto& thread = d["thread"];
+            if (thread.HasMember("domain_rank") && thread["domain_rank"].IsNumber()) {
+                document.domainRank = static_cast<long long>(thread["domain_rank"].GetDouble());
+            }
+            if (thread.HasMember("spam_score") && thread["spam_score"].IsNumber()) {
+                document.spamScore = thread["spam_score"].GetDouble();
+            }
+            if (thread.HasMember("site") && thread["site"].IsString()) {
+                document.hasSite = true;
+                document.site = thread["site"].GetString();
+            }
         }
 
-        IStreamWrapper isw(input);
-        Document d;
-        d.ParseStream(isw);
-
         string docText = d["text"].GetString();
+        if (dedupeExact) {
+            document.uuid = d.HasMember("uuid") && d["uuid"].IsString() ? d["uuid"].GetString() : "";
+            document.textHash = NearDuplicateDetector::hashString(docText);
+        }
+
+        // Analyze the text one stage at a time over all tokens, so each stage is timed once per document
+        start = phaseStart(IndexingProfile::TOKENIZE, profile);
         vector<string> tokens = tokenizer(docText);
+        phaseEnd(IndexingProfile::TOKENIZE, start, profile);
 
+        start = phaseStart(IndexingProfile::PUNCTUATION, profile);
         for (auto& token : tokens) {
             token = removePunctuation(token);
+        }
+        phaseEnd(IndexingProfile::PUNCTUATION, start, profile);
+
+        start = phaseStart(IndexingProfile::LOWERCASE, profile);
+        for (auto& token : tokens) {
             token = toLower(token);
+        }
+        phaseEnd(IndexingProfile::LOWERCASE, start, profile);
+
+        start = phaseStart(IndexingProfile::STEM, profile);
+        for (auto& token : tokens) {
             token = stemWord(token);
         }
+        phaseEnd(IndexingProfile::STEM, start, profile);
+
+        start = phaseStart(IndexingProfile::STOP_WORDS, profile);
+        if (profile != nullptr) {
+            profile->addTokens(tokens.size());
+        }
+        tokens.erase(remove_if(tokens.begin(), tokens.end(),
+                               [](const string& token) { return token.empty() || containsStopWords(token); }),
+                     tokens.end());
+        phaseEnd(IndexingProfile::STOP_WORDS, start, profile);
+        document.tokens = move(tokens);
+
+        if (d.HasMember("published") && d["published"].IsString()) {
+            document.published = DocumentTable::parseTimestamp(d["published"].GetString());
+        }
+        if (d.HasMember("author") && d["author"].IsString()) {
+            document.hasAuthor = true;
+            document.author = d["author"].GetString();
+        }
+        if (d.HasMember("entities") && d["entities"].IsObject()) {
+            const auto& entities = d["entities"];
+            if (entities.HasMember("persons") && entities["persons"].IsArray()) {
+                for (const auto& person : entities["persons"].GetArray()) {
+                    document.persons.push_back(person["name"].GetString());
+                }
+            }
+            if (entities.HasMember("organizations") && entities["organizations"].IsArray()) {
+                for (const auto& org : entities["organizations"].GetArray()) {
+                    document.organizations.push_back(org["name"].GetString());
+                }
+            }
+        }
+    }
+
+   private:
+    /**
+     * @brief Counts the tree inserts a document makes: its words plus its entity name tokens.
+     */
+    static size_t countInserts(const AnalyzedDocument& document) {
+        size_t inserts = document.tokens.size();
+        for (const auto& personName : document.persons) {
+            inserts += tokenizer(personName).size();
+        }
+        for (const auto& orgName : document.organizations) {
+            inserts += tokenizer(orgName).size();
+        }
+        return inserts;
+    }
 
-        for (const auto& token : tokens) {
-            if (!containsStopWords(token) && !token.empty()) {
-                pushToTreeWord(token, documentName, 1);
+    /**
+     * @brief Checks an analyzed document against the index-time filters, counting it if it is dropped.
+     * @return True if the document should be indexed.
+     */
+    bool passesFilters(const AnalyzedDocument& document) {
+        if (maxSpamScore >= 0 && document.spamScore > maxSpamScore) {
+            spamSkipped++;
+            return false;
+        }
+
+        // Exact duplicates: the same uuid or byte-identical text
+        if (dedupeExact) {
+            bool seenUuid = !document.uuid.empty() && !seenUuids.insert(document.uuid).second;
+            bool seenText = !seenContentHashes.insert(document.textHash).second;
+            if (seenUuid || seenText) {
+                duplicatesSkipped++;
+                return false;
             }
         }
 
+        // Near duplicates (e.g. syndicated wire stories) are compared on the analyzed words
+        if (dedupeNear && nearDuplicates.isNearDuplicate(document.tokens)) {
+            nearDuplicatesSkipped++;
+            return false;
+        }
+        return true;
+    }
+
+   public:
+    /**
+     * @brief Applies the index-time filters to an analyzed document and, if it is kept, records
+     *        its columns and adds its tokens to the AVL trees.
+     * @param document A document filled by analyzeDocument.
+     */
+    void indexAnalyzed(const AnalyzedDocument& document) {
+        const string& documentName = document.name;
+        if (!document.valid) {
+            cerr << "Skipping invalid document: " << documentName << endl;
+            return;
+        }
+        if (maxSpamScore >= 0 || dedupeExact || dedupeNear) {
+            auto filterStart = chrono::steady_clock::now();
+            bool kept = passesFilters(document);
+            filterSeconds += chrono::duration<double>(chrono::steady_clock::now() - filterStart).count();
+            if (!kept) {
+                tokensSkipped += countInserts(document);
+                return;
+            }
+        }
+
+        // Record the publication date as a column so date filters never reopen the file
+        int docID = Documents.addDocument(documentName);
+        Documents.setPublished(docID, document.published);
+
+        // Capture low-cardinality fields as dictionary-encoded facet columns
+        if (document.hasSite) {
+            Documents.addFacetValue(docID, "site", document.site);
+        }
+        if (document.hasAuthor) {
+            Documents.addFacetValue(docID, "author", document.author);
+        }
+
+        // Fold the site's rank and the spam probability into a static quality prior
+        Documents.setStaticScore(docID, DocumentTable::computeStaticScore(document.domainRank, document.spamScore));
+
+        // Route this document's tokens to its month partition when partitioning is enabled
+        if (Partitions != nullptr) {
+            TimePartitionedIndex::Partition& partition = Partitions->partitionFor(Documents.getPublished(docID));
+            targetPersonTree = &partition.PersonTree;
+            targetOrganizationTree = &partition.OrganizationTree;
+            targetWordsTree = &partition.WordsTree;
+        }
+
+        auto start = phaseStart(IndexingProfile::INSERT, Profile);
+        size_t inserts = document.tokens.size();
+        for (const auto& token : document.tokens) {
+            pushToTreeWord(token, documentName, 1);
+        }
+
         // Index persons from the document
-        auto docPersons = d["entities"]["persons"].GetArray();
-        for (const auto& person : docPersons) {
-            string personName = person["name"].GetString();
+        for (const auto& personName : document.persons) {
             for (const auto& name : tokenizer(personName)) {
                 pushToTreePerson(name, documentName, 1);
+                ++inserts;
             }
         }
 
         // Index organizations from the document
-        auto docOrgs = d["entities"]["organizations"].GetArray();
-        for (const auto& org : docOrgs) {
-            string orgName = org["name"].GetString();
+        for (const auto& orgName : document.organizations) {
+            Documents.addFacetValue(docID, "organization", orgName);
             for (const auto& org : tokenizer(orgName)) {
                 pushToTreeOrg(org, documentName, 1);
+                ++inserts;
+            }
+        }
+        phaseEnd(IndexingProfile::INSERT, start, Profile);
+        tokensIndexed += inserts;
+        if (Profile != nullptr) {
+            Profile->addInserts(inserts);
+        }
+        if (Spimi != nullptr) {
+            Spimi->afterDocument(PersonTree, OrganizationTree, WordsTree);
+        }
+    }
+
+    /**
+     * @struct ReadAhead
+     * @brief A document file being read (and decompressed) on a worker thread; `content` is
+     *        filled once `loaded` is ready.
+     */
+    struct ReadAhead {
+        future<bool> loaded;
+        string content;
+    };
+
+    /**
+     * @brief Reads a document file whole; gzip files are decompressed.
+     * @return False if the file cannot be opened or is corrupt.
+     */
+    static bool readDocumentFile(const string& documentName, string& content) {
+        if (GzipFile::isGzipFile(documentName)) {
+            return GzipFile::readAll(documentName, content);
+        }
+        ifstream input(documentName, ios::binary);
+        if (!input.is_open()) {
+            return false;
+        }
+        content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+        return true;
+    }
+
+    /**
+     * @brief Processes and indexes a document.
+     *        It filters stop words, removes punctuation, converts text to lowercase,
+     *        stems words, and adds them to AVL trees for indexing.
+     * @param documentName The path to the document file; gzip files (.json.gz) are decompressed.
+     * @param readAhead The document already being read on a worker thread, or nullptr to read it here.
+     */
+    void runDocument(string documentName, ReadAhead* readAhead = nullptr) {
+        Trace::Span span("runDocument", "index", &documentName);
+        AllocationTracker::Scope allocations(AllocationTracker::OTHER); // Restored on every return
+        filesIndexed++;
+        if (stopWords.empty()) {
+            loadStopWords("stopWords.txt");
+        }
+
+        auto start = phaseStart(IndexingProfile::READ, Profile);
+        string content;
+        bool loaded;
+        if (readAhead != nullptr) {
+            loaded = readAhead->loaded.get();
+            content = move(readAhead->content);
+        } else {
+            loaded = readDocumentFile(documentName, content);
+        }
+        if (!loaded) {
+            cerr << (GzipFile::isGzipFile(documentName) ? "Cannot read compressed file: " : "Cannot open file: ")
+                 << documentName << endl;
+            return;
+        }
+        phaseEnd(IndexingProfile::READ, start, Profile);
+        if (Profile != nullptr) {
+            Profile->addDocument(content.size());
+        }
+
+        AnalyzedDocument document;
+        document.name = documentName;
+        analyzeDocument(content.data(), content.size(), document, Profile);
+        indexAnalyzed(document);
+    }
+
+    /**
+     * @brief Indexes every record of a JSON Lines (.jsonl, .ndjson, either optionally .gz) or concatenated-JSON file.
+     *        The file is streamed through a large buffer and split at record boundaries. The
+     *        records of each buffer are parsed and analyzed by the analysis threads while this
+     *        thread indexes the previous buffer's records in file order, so document IDs do not
+     *        depend on the thread count. Each record is named by its "file#offset" locator.
+     * @param filePath The file to index.
+     * @return The number of records read.
+     */
+    size_t runRecordFile(const string& filePath) {
+        Trace::Span span("runRecordFile", "index", &filePath);
+        AllocationTracker::Scope allocations(AllocationTracker::OTHER);
+        if (stopWords.empty()) {
+            loadStopWords("stopWords.txt");
+        }
+        JsonRecordReader reader(filePath, JsonRecordReader::isJsonLinesFile(filePath));
+        if (!reader.isOpen()) {
+            cerr << "Cannot open file: " << filePath << endl;
+            return 0;
+        }
+
+        // Worker threads record into their own profiles, merged once the file is done; the last one is the reader's
+        vector<IndexingProfile> workerProfiles(Profile != nullptr ? analysisThreads + 1 : 0);
+        auto profileOf = [&](size_t worker) { return Profile != nullptr ? &workerProfiles[worker] : nullptr; };
+        vector<JsonRecordReader::Record> records;
+
+        // Reads the next buffer and analyzes its records in parallel; false once the file is exhausted
+        auto analyzeBatch = [&](vector<AnalyzedDocument>& batch) {
+            IndexingProfile* readProfile = profileOf(analysisThreads);
+            auto start = phaseStart(IndexingProfile::READ, readProfile);
+            bool more = reader.nextBatch(records);
+            phaseEnd(IndexingProfile::READ, start, readProfile);
+            batch.assign(records.size(), AnalyzedDocument());
+
+            atomic<size_t> nextRecord(0);
+            auto analyze = [&](size_t worker) {
+                IndexingProfile* profile = profileOf(worker);
+                for (size_t i = nextRecord++; i < records.size(); i = nextRecord++) {
+                    batch[i].name = JsonRecordReader::makeLocator(filePath, records[i].offset);
+                    if (profile != nullptr) {
+                        profile->addDocument(records[i].length);
+                    }
+                    analyzeDocument(records[i].data, records[i].length, batch[i], profile);
+                }
+            };
+            vector<thread> workers;
+            for (size_t worker = 1; worker < analysisThreads; ++worker) {
+                workers.emplace_back([&analyze, worker] {
+                    Trace::setThreadName("analyze " + to_string(worker));
+                    analyze(worker);
+                });
             }
+            analyze(0);
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            return more;
+        };
+
+        vector<AnalyzedDocument> current;
+        vector<AnalyzedDocument> next;
+        size_t recordCount = 0;
+        bool more = analyzeBatch(current);
+        while (more) {
+            future<bool> pending = async(launch::async, [&] {
+                Trace::setThreadName("read");
+                return analyzeBatch(next);
+            });
+            for (const auto& document : current) {
+                Trace::Span recordSpan("indexRecord", "index", &document.name);
+                filesIndexed++;
+                indexAnalyzed(document);
+            }
+            recordCount += current.size();
+            more = pending.get();
+            swap(current, next);
+        }
+        if (GzipFile::isGzipFile(filePath)) {
+            GzipSeekIndex::add(filePath, reader.takeSeekPoints());
         }
+        for (const auto& profile : workerProfiles) {
+            Profile->merge(profile);
+        }
+        return recordCount;
+    }
 
-        input.close();
+    /**
+     * @brief Indexes the files of a prefetched walk. The prefetcher has read each document into
+     *        memory, so the analysis threads parse and analyze a batch of them without waiting
+     *        on disk, while this thread indexes the previous batch. Files the prefetcher passed
+     *        through are indexed with runFile once their turn in the batch comes.
+     * @param files The prefetched files; it should pass through the files runFile streams as records.
+     * @param concatenated True to read passed-through files as concatenated JSON documents.
+     * @return The number of files indexed.
+     */
+    size_t runPrefetched(FilePrefetcher& files, bool concatenated = false) {
+        Trace::Span span("runPrefetched", "index");
+        AllocationTracker::Scope allocations(AllocationTracker::OTHER);
+        if (stopWords.empty()) {
+            loadStopWords("stopWords.txt");  // Before any analysis thread reads the stop words
+        }
+
+        // As in runRecordFile: one profile per analysis thread, and the last one for waiting on the prefetcher
+        vector<IndexingProfile> workerProfiles(Profile != nullptr ? analysisThreads + 1 : 0);
+        auto profileOf = [&](size_t worker) { return Profile != nullptr ? &workerProfiles[worker] : nullptr; };
+
+        // Takes the next batch of files and analyzes the loaded ones in parallel; false once none are left
+        auto analyzeBatch = [&](vector<FilePrefetcher::File>& batch, vector<AnalyzedDocument>& documents) {
+            IndexingProfile* readProfile = profileOf(analysisThreads);
+            auto start = phaseStart(IndexingProfile::READ, readProfile);
+            batch.resize(PREFETCH_BATCH_FILES);
+            size_t count = 0;
+            while (count < batch.size() && files.next(batch[count])) {
+                ++count;
+            }
+            batch.resize(count);
+            phaseEnd(IndexingProfile::READ, start, readProfile);
+            documents.assign(count, AnalyzedDocument());
+
+            atomic<size_t> nextFile(0);
+            auto analyze = [&](size_t worker) {
+                IndexingProfile* profile = profileOf(worker);
+                for (size_t i = nextFile++; i < count; i = nextFile++) {
+                    if (!batch[i].loaded) {
+                        continue;
+                    }
+                    documents[i].name = batch[i].path;
+                    if (profile != nullptr) {
+                        profile->addDocument(batch[i].content.size());
+                    }
+                    analyzeDocument(batch[i].content.data(), batch[i].content.size(), documents[i], profile);
+                    files.recycle(move(batch[i].content));
+                }
+            };
+            vector<thread> workers;
+            for (size_t worker = 1; worker < analysisThreads; ++worker) {
+                workers.emplace_back([&analyze, worker] {
+                    Trace::setThreadName("analyze " + to_string(worker));
+                    analyze(worker);
+                });
+            }
+            analyze(0);
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            return count > 0;
+        };
+
+        vector<FilePrefetcher::File> currentFiles, nextFiles;
+        vector<AnalyzedDocument> current, next;
+        size_t fileCount = 0;
+        bool more = analyzeBatch(currentFiles, current);
+        while (more) {
+            future<bool> pending = async(launch::async, [&] {
+                Trace::setThreadName("prefetch");
+                return analyzeBatch(nextFiles, next);
+            });
+            for (size_t i = 0; i < current.size(); ++i) {
+                const FilePrefetcher::File& file = currentFiles[i];
+                if (file.passedThrough) {
+                    runFile(file.path, concatenated);
+                    continue;
+                }
+                Trace::Span documentSpan("indexDocument", "index", &file.path);
+                filesIndexed++;
+                if (!file.loaded) {
+                    cerr << (GzipFile::isGzipFile(file.path) ? "Cannot read compressed file: " : "Cannot open file: ")
+                         << file.path << endl;
+                    continue;
+                }
+                indexAnalyzed(current[i]);
+            }
+            fileCount += current.size();
+            more = pending.get();
+            swap(currentFiles, nextFiles);
+            swap(current, next);
+        }
+        for (const auto& profile : workerProfiles) {
+            Profile->merge(profile);
+        }
+        return fileCount;
+    }
+
+    /**
+     * @brief Indexes the files of a walk in the order they are found. Compressed articles
+     *        (.json.gz) are decompressed one file ahead on a worker thread, so inflating a file
+     *        overlaps parsing and indexing the one before it. With a single analysis thread
+     *        (one core) there is nothing to overlap with, so every file is read in turn.
+     * @param files The walk to take files from.
+     * @param concatenated True to read every file as concatenated JSON documents.
+     * @return The number of files indexed.
+     */
+    size_t runWalk(DirectoryWalker& files, bool concatenated = false) {
+        // Starts decompressing a file if it is a single compressed article; record files stream themselves
+        bool overlap = analysisThreads > 1;
+        auto startReadAhead = [concatenated, overlap](const string& path) {
+            unique_ptr<ReadAhead> readAhead;
+            if (overlap && !concatenated && GzipFile::isGzipFile(path) && !JsonRecordReader::isJsonLinesFile(path)) {
+                readAhead = make_unique<ReadAhead>();
+                ReadAhead* target = readAhead.get();
+                target->loaded = async(launch::async, [target, path] {
+                    Trace::setThreadName("inflate");
+                    return readDocumentFile(path, target->content);
+                });
+            }
+            return readAhead;
+        };
+
+        size_t fileCount = 0;
+        string path, nextPath;
+        bool more = files.next(path);
+        unique_ptr<ReadAhead> readAhead = more ? startReadAhead(path) : nullptr;
+        while (more) {
+            bool nextMore = files.next(nextPath);
+            unique_ptr<ReadAhead> nextReadAhead = nextMore ? startReadAhead(nextPath) : nullptr;
+            if (readAhead != nullptr) {
+                runDocument(path, readAhead.get());
+            } else {
+                runFile(path, concatenated);
+            }
+            ++fileCount;
+            more = nextMore;
+            swap(path, nextPath);
+            readAhead = move(nextReadAhead);
+        }
+        return fileCount;
+    }
+
+    /**
+     * @brief Indexes a file: JSON Lines files record by record, any other file as one document.
+     * @param filePath The file to index.
+     * @param concatenated True to read any file as concatenated JSON documents.
+     */
+    void runFile(const string& filePath, bool concatenated = false) {
+        if (concatenated || JsonRecordReader::isJsonLinesFile(filePath)) {
+            runRecordFile(filePath);
+        } else {
+            runDocument(filePath);
+        }
+    }
+
+    /**
+     * @struct VocabularyPruneStats
+     * @brief What pruneVocabulary removed from the words index.
+     */
+    struct VocabularyPruneStats {
+        size_t termsBefore = 0;
+        size_t rareTermsDropped = 0;
+        size_t stopWordsPromoted = 0;
+        size_t postingsBefore = 0;
+        size_t postingsRemoved = 0;
+        size_t bytesBefore = 0;   // Estimated heap bytes of the words trees (AvlTree::memoryUsage)
+        size_t bytesAfter = 0;
+    };
+
+    /**
+     * @brief Prunes the words index after indexing. Terms found in fewer than minDocFrequency
+     *        documents (typos, numbers, URL fragments) are dropped, and terms found in more than
+     *        maxDocFrequencyRatio of all documents are dropped and promoted to generated stop words.
+     *        Document frequencies are counted across all time partitions.
+     * @param minDocFrequency The smallest document frequency that is kept (1 keeps everything).
+     * @param maxDocFrequencyRatio The largest fraction of documents a kept term may appear in.
+     * @return Counts of what was removed.
+     */
+    VocabularyPruneStats pruneVocabulary(size_t minDocFrequency, double maxDocFrequencyRatio) {
+        vector<AvlTree<string>*> trees;
+        if (Partitions != nullptr) {
+            for (auto* partition : Partitions->overlapping(DocumentTable::NO_TIMESTAMP, DocumentTable::NO_TIMESTAMP, false)) {
+                trees.push_back(&partition->WordsTree);
+            }
+        } else {
+            trees.push_back(&WordsTree);
+        }
+
+        VocabularyPruneStats stats;
+        unordered_map<string, size_t> docFrequency;
+        for (auto* tree : trees) {
+            stats.bytesBefore += tree->memoryUsage().totalBytes();
+            tree->forEachNode([&](const string& key, const map<string, int>& wordMap) {
+                docFrequency[key] += wordMap.size();
+                stats.postingsBefore += wordMap.size();
+            });
+        }
+        stats.termsBefore = docFrequency.size();
+
+        double maxDocFrequency = maxDocFrequencyRatio * Documents.getSize();
+        for (const auto& term : docFrequency) {
+            if (term.second < minDocFrequency) {
+                stats.rareTermsDropped++;
+            } else if (term.second > maxDocFrequency) {
+                stats.stopWordsPromoted++;
+                generatedStopWords.push_back(term.first);
+                stopWords.insert(term.first);
+            }
+        }
+        sort(generatedStopWords.begin(), generatedStopWords.end());
+
+        for (auto* tree : trees) {
+            tree->removeKeysIf([&](const string& key, const map<string, int>& wordMap) {
+                size_t frequency = docFrequency[key];
+                bool remove = frequency < minDocFrequency || frequency > maxDocFrequency;
+                if (remove) {
+                    stats.postingsRemoved += wordMap.size();
+                }
+                return remove;
+            });
+            stats.bytesAfter += tree->memoryUsage().totalBytes();
+        }
+        return stats;
+    }
+
+    /**
+     * @brief Writes the stop words generated by pruneVocabulary, one per line.
+     * @param filePath Path of the generated stop list.
+     */
+    void writeGeneratedStopWords(const string& filePath) const {
+        ofstream file(filePath);
+        if (!file.is_open()) {
+            cerr << "Unable to open stop words file: " << filePath << endl;
+            return;
+        }
+        for (const auto& word : generatedStopWords) {
+            file << word << "\n";
+        }
+        file.close();
+    }
+
+    /**
+     * @brief Finishes a batch of indexed documents by reassigning document IDs in
+     *        descending static-score order, so ranking can stop early on quality order.
+     */
+    void finishIndexing() {
+        Documents.reorderByStaticScore();
     }
 
     // Functions to insert tokens into the respective AVL trees
     void pushToTreePerson(string token, string docName, int frequency) {
-        PersonTree.insert(token, docName, frequency);
+        targetPersonTree->insert(token, docName, frequency);
     }
 
     void pushToTreeOrg(string token, string docName, int frequency) {
-        OrganizationTree.insert(token, docName, frequency);
+        targetOrganizationTree->insert(token, docName, frequency);
     }
 
     void pushToTreeWord(string token, string docName, int frequency) {
-        WordsTree.insert(token, docName, frequency);
+        targetWordsTree->insert(token, docName, frequency);
     }
 
     /**
      * @brief Prints a document's title and publication date from a JSON file.
-     * @param filename The path to the document file.
+     * @param filename The path to the document file, or a "file#offset" record locator.
      */
     static void printDocument(const string& filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
+        string content;
+        if (!JsonRecordReader::readDocument(filename, content)) {
             cerr << "Error: Unable to open file: " << filename << endl;
             return;
         }
 
-        IStreamWrapper isw(file);
         Document doc;
-        doc.ParseStream(isw);
+        doc.Parse(content.c_str(), content.size());
 
         cout << "Article Name: " << doc["title"].GetString()
              << " Publication Date: " << doc["published"].GetString() << endl;
-
-        file.close();
     }
 
     /**
      * @brief Prints the main text content of a document from a JSON file.
-     * @param filename The path to the document file.
+     * @param filename The path to the document file, or a "file#offset" record locator.
      */
     void printDocumentText(const string& filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
+        string content;
+        if (!JsonRecordReader::readDocument(filename, content)) {
             cerr << "Unable to open file: " << filename << endl;
             return;
         }
 
-        IStreamWrapper isw(file);
         Document document;
-        document.ParseStream(isw);
+        document.Parse(content.c_str(), content.size());
 
         if (!document.HasMember("text") || !document["text"].IsString()) {
             cerr << "Text not found in JSON file: " << filename << endl;
@@ -255,20 +1016,27 @@ class DocumentParser {
         }
 
         cout << document["text"].GetString() << endl;
-
-        file.close();
     }
 
     /**
-     * @brief Serializes and writes the trees to files.
+     * @brief Serializes and writes the trees to files. Under a memory budget, the trees hold
+     *        only the last partial run, so it is flushed and all runs are merged into the files.
      * @param personFile The file path for storing the persons tree.
      * @param orgFile The file path for storing the organizations tree.
      * @param wordFile The file path for storing the words tree.
+     * @param documentFile The file path for storing the document table.
      */
-    void toFile(const string& personFile, const string& orgFile, const string& wordFile) {
-        PersonTree.writeToTextFile(personFile);
-        OrganizationTree.writeToTextFile(orgFile);
-        WordsTree.writeToTextFile(wordFile);
+    void toFile(const string& personFile, const string& orgFile, const string& wordFile,
+                const string& documentFile) {
+        Trace::Span span("saveIndex", "index");
+        if (Spimi != nullptr) {
+            spimiStats = Spimi->finish(PersonTree, OrganizationTree, WordsTree, personFile, orgFile, wordFile);
+        } else {
+            PersonTree.writeToTextFile(personFile);
+            OrganizationTree.writeToTextFile(orgFile);
+            WordsTree.writeToTextFile(wordFile);
+        }
+        Documents.writeToTextFile(documentFile);
     }
 
     /**
@@ -278,6 +1046,49 @@ class DocumentParser {
     int getFilesIndexed() const {
         return filesIndexed;
     }
+
+    /**
+     * @brief Returns the number of documents skipped for exceeding the spam threshold.
+     */
+    int getSpamSkipped() const {
+        return spamSkipped;
+    }
+
+    /**
+     * @brief Returns the number of documents skipped as exact duplicates.
+     */
+    int getDuplicatesSkipped() const {
+        return duplicatesSkipped;
+    }
+
+    /**
+     * @brief Returns the number of documents skipped as near duplicates.
+     */
+    int getNearDuplicatesSkipped() const {
+        return nearDuplicatesSkipped;
+    }
+
+    /**
+     * @brief Returns the number of token occurrences added to the trees.
+     */
+    size_t getTokensIndexed() const {
+        return tokensIndexed;
+    }
+
+    /**
+     * @brief Returns the number of token occurrences of documents dropped by the filters.
+     */
+    size_t getTokensSkipped() const {
+        return tokensSkipped;
+    }
+
+    /**
+     * @brief Returns the seconds spent checking documents against the filters, excluding the
+     *        text hashing done while analyzing them.
+     */
+    double getFilterSeconds() const {
+        return filterSeconds;
+    }
 };
 
 set<string> DocumentParser::stopWords;
@@ -0,0 +1,265 @@
+#ifndef DOCUMENT_REORDERER_H
+#define DOCUMENT_REORDERER_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AvlTree.h"
+#include "DocumentTable.h"
+#include "JsonRecordReader.h"
+#include "rapidjson/document.h"       // For reading article URLs
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * @class DocumentReorderer
+ * @brief Computes locality-improving document ID orders for a persisted index and estimates
+ * how compactly its postings could be stored. Similar documents share terms, so giving them
+ * nearby IDs shrinks the gaps between consecutive IDs in each posting list. The persisted
+ * postings are keyed by document path, so the gains are those of a docID-keyed, gap-coded
+ * format; renumbering alone does not shrink the index files.
+ */
+class DocumentReorderer {
+   private:
+    // Ranges at or below this size are not split further by graph bisection
+    static const size_t MIN_BISECTION_SIZE = 16;
+
+    /**
+     * @brief Estimated bits needed by the postings of one term on one side of a split.
+     * @param degree Number of documents on that side that contain the term.
+     * @param size Number of documents on that side.
+     */
+    static double logGapCost(int degree, size_t size) {
+        return degree * log2(static_cast<double>(size) / (degree + 1));
+    }
+
+    /**
+     * @brief Recursively splits order[begin, end) in two halves, swapping documents between
+     *        the halves while that lowers the estimated posting cost, then recurses into each half.
+     */
+    static void bisect(vector<int>& order, size_t begin, size_t end, const vector<vector<int>>& docTerms,
+                       vector<int>& leftDegree, vector<int>& rightDegree, int iterations) {
+        if (end - begin <= MIN_BISECTION_SIZE) {
+            return;
+        }
+        size_t middle = begin + (end - begin) / 2;
+        size_t leftSize = middle - begin;
+        size_t rightSize = end - middle;
+
+        vector<pair<double, size_t>> leftGains, rightGains;
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (size_t i = begin; i < end; ++i) {
+                for (int term : docTerms[order[i]]) {
+                    ++(i < middle ? leftDegree : rightDegree)[term];
+                }
+            }
+
+            // Gain of moving each document to the other half
+            leftGains.clear();
+            rightGains.clear();
+            for (size_t i = begin; i < end; ++i) {
+                double gain = 0;
+                for (int term : docTerms[order[i]]) {
+                    int dl = leftDegree[term];
+                    int dr = rightDegree[term];
+                    double before = logGapCost(dl, leftSize) + logGapCost(dr, rightSize);
+                    double after = i < middle ? logGapCost(dl - 1, leftSize) + logGapCost(dr + 1, rightSize)
+                                              : logGapCost(dl + 1, leftSize) + logGapCost(dr - 1, rightSize);
+                    gain += before - after;
+                }
+                (i < middle ? leftGains : rightGains).emplace_back(gain, i);
+            }
+
+            for (size_t i = begin; i < end; ++i) {
+                for (int term : docTerms[order[i]]) {
+                    leftDegree[term] = rightDegree[term] = 0;
+                }
+            }
+
+            // Swap the most eager pairs while the swap still pays off
+            sort(leftGains.rbegin(), leftGains.rend());
+            sort(rightGains.rbegin(), rightGains.rend());
+            size_t swaps = 0;
+            for (size_t i = 0; i < leftGains.size() && i < rightGains.size(); ++i) {
+                if (leftGains[i].first + rightGains[i].first <= 0) {
+                    break;
+                }
+                swap(order[leftGains[i].second], order[rightGains[i].second]);
+                ++swaps;
+            }
+            if (swaps == 0) {
+                break;
+            }
+        }
+
+        bisect(order, begin, middle, docTerms, leftDegree, rightDegree, iterations);
+        bisect(order, middle, end, docTerms, leftDegree, rightDegree, iterations);
+    }
+
+    /**
+     * @brief Normalizes a URL for sorting: drops the scheme and a leading "www." so
+     *        pages of the same site end up next to each other.
+     */
+    static string urlSortKey(string url) {
+        size_t scheme = url.find("://");
+        if (scheme != string::npos) {
+            url = url.substr(scheme + 3);
+        }
+        if (url.compare(0, 4, "www.") == 0) {
+            url = url.substr(4);
+        }
+        return url;
+    }
+
+   public:
+    /**
+     * @brief Orders documents by their article URL (falling back to site and path when the
+     *        file cannot be read), which groups documents of the same site and section.
+     * @param documents The document table.
+     * @return The new order: the document with old ID order[i] gets ID i.
+     */
+    static vector<int> orderByUrl(const DocumentTable& documents) {
+        const DocumentTable::FacetColumn* sites = documents.getFacet("site");
+        vector<pair<string, int>> keys;
+        keys.reserve(documents.getSize());
+        for (int docID = 0; docID < static_cast<int>(documents.getSize()); ++docID) {
+            string key;
+            string content;
+            if (JsonRecordReader::readDocument(documents.getName(docID), content)) {
+                Document d;
+                d.Parse(content.c_str(), content.size());
+                if (!d.HasParseError() && d.IsObject() && d.HasMember("url") && d["url"].IsString()) {
+                    key = urlSortKey(d["url"].GetString());
+                }
+            }
+            if (key.empty()) {
+                bool hasSite = sites->starts[docID] < sites->starts[docID + 1];
+                key = (hasSite ? sites->dictionary[sites->values[sites->starts[docID]]] : "") + "/" +
+                      documents.getName(docID);
+            }
+            keys.emplace_back(key, docID);
+        }
+        sort(keys.begin(), keys.end());
+
+        vector<int> order;
+        order.reserve(keys.size());
+        for (const auto& key : keys) {
+            order.push_back(key.second);
+        }
+        return order;
+    }
+
+    /**
+     * @brief Orders documents by recursive graph bisection of the document-term graph:
+     *        documents are split in halves that share as many terms as possible, recursively.
+     * @param words The words tree that provides each document's terms.
+     * @param documents The document table.
+     * @param iterations Swap rounds per split.
+     * @return The new order: the document with old ID order[i] gets ID i.
+     */
+    static vector<int> orderByBisection(const AvlTree<string>& words, const DocumentTable& documents,
+                                        int iterations = 10) {
+        vector<vector<int>> docTerms(documents.getSize());
+        int numTerms = 0;
+        words.forEachNode([&](const string&, const map<string, int>& wordMap) {
+            for (const auto& posting : wordMap) {
+                int docID = documents.getID(posting.first);
+                if (docID >= 0) {
+                    docTerms[docID].push_back(numTerms);
+                }
+            }
+            ++numTerms;
+        });
+
+        vector<int> order(documents.getSize());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<int>(i);
+        }
+        vector<int> leftDegree(numTerms, 0);
+        vector<int> rightDegree(numTerms, 0);
+        bisect(order, 0, order.size(), docTerms, leftDegree, rightDegree, iterations);
+        return order;
+    }
+
+    /**
+     * @brief Keeps documents in descending static-score order, which ranking needs to stop early,
+     *        and applies a locality order only among documents with equal static scores.
+     * @param locality An order from orderByUrl or orderByBisection.
+     * @param documents The document table.
+     * @return The new order: the document with old ID order[i] gets ID i.
+     */
+    static vector<int> withinStaticScoreTies(const vector<int>& locality, const DocumentTable& documents) {
+        vector<int> position(locality.size());
+        for (size_t i = 0; i < locality.size(); ++i) {
+            position[locality[i]] = static_cast<int>(i);
+        }
+        vector<int> order(locality);
+        sort(order.begin(), order.end(), [&](int a, int b) {
+            double scoreA = documents.getStaticScore(a);
+            double scoreB = documents.getStaticScore(b);
+            return scoreA != scoreB ? scoreA > scoreB : position[a] < position[b];
+        });
+        return order;
+    }
+
+    /**
+     * @brief Counts the documents whose static score equals another document's, i.e. the
+     *        documents withinStaticScoreTies is free to reorder.
+     */
+    static size_t countStaticScoreTies(const DocumentTable& documents) {
+        vector<double> scores;
+        scores.reserve(documents.getSize());
+        for (int docID = 0; docID < static_cast<int>(documents.getSize()); ++docID) {
+            scores.push_back(documents.getStaticScore(docID));
+        }
+        sort(scores.begin(), scores.end());
+        size_t tied = 0;
+        for (size_t i = 0; i < scores.size(); ++i) {
+            bool sameAsPrevious = i > 0 && scores[i] == scores[i - 1];
+            bool sameAsNext = i + 1 < scores.size() && scores[i] == scores[i + 1];
+            tied += sameAsPrevious || sameAsNext;
+        }
+        return tied;
+    }
+
+    /**
+     * @brief Estimates the average bits per posting if every posting list were stored as
+     *        Elias-gamma coded gaps between consecutive document IDs.
+     * @param trees The trees whose postings are measured.
+     * @param documents The document table that assigns the IDs.
+     * @return The average number of bits per posting, or 0 if there are no postings.
+     */
+    static double bitsPerPosting(const vector<const AvlTree<string>*>& trees, const DocumentTable& documents) {
+        double bits = 0;
+        size_t postings = 0;
+        vector<int> docIDs;
+        for (const auto* tree : trees) {
+            tree->forEachNode([&](const string&, const map<string, int>& wordMap) {
+                docIDs.clear();
+                for (const auto& posting : wordMap) {
+                    int docID = documents.getID(posting.first);
+                    if (docID >= 0) {
+                        docIDs.push_back(docID);
+                    }
+                }
+                sort(docIDs.begin(), docIDs.end());
+
+                int previous = -1;
+                for (int docID : docIDs) {
+                    unsigned gap = static_cast<unsigned>(docID - previous);
+                    bits += 2 * floor(log2(static_cast<double>(gap))) + 1;
+                    previous = docID;
+                }
+                postings += docIDs.size();
+            });
+        }
+        return postings == 0 ? 0 : bits / postings;
+    }
+};
+
+#endif  // DOCUMENT_REORDERER_H
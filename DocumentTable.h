@@ -0,0 +1,555 @@
+#ifndef DOCUMENT_TABLE_H
+#define DOCUMENT_TABLE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryAccounting.h"
+
+using namespace std;
+
+/**
+ * @class DocumentTable
+ * @brief Assigns each indexed document a dense integer ID and stores per-document
+ * columns (the publication timestamp, a static quality score and dictionary-encoded
+ * facet fields) so queries can filter, rank and aggregate on them without reopening
+ * the JSON files.
+ */
+class DocumentTable {
+   public:
+    /**
+     * @struct FacetColumn
+     * @brief A dictionary-encoded, possibly multi-valued column of low-cardinality strings.
+     * Each distinct value gets a small integer code; the codes of document d are
+     * values[starts[d] .. starts[d + 1]), so counting over a set of documents is a tight array loop.
+     */
+    struct FacetColumn {
+        vector<string> dictionary;              // Code to value
+        unordered_map<string, uint32_t> codes;  // Value to code
+        vector<uint32_t> starts{0};             // Offset of each document's first code (one extra at the end)
+        vector<uint32_t> values;                // Codes of all documents, in document ID order
+    };
+
+    /**
+     * @struct MemoryUsage
+     * @brief Estimated heap bytes held by the table, split by what holds them.
+     */
+    struct MemoryUsage {
+        size_t nameBytes = 0;       // Document path strings and the ID-to-name array
+        size_t idIndexBytes = 0;    // Name-to-ID hash table (its keys are counted as names)
+        size_t columnBytes = 0;     // Publication, static-score and sorted-publication columns
+        size_t facetBytes = 0;      // Facet dictionaries, code tables and code arrays
+
+        size_t totalBytes() const {
+            return nameBytes + idIndexBytes + columnBytes + facetBytes;
+        }
+    };
+
+    // Names of the facet fields, in the order they are stored and persisted
+    static const vector<string>& facetFields() {
+        static const vector<string> fields = {"site", "author", "organization"};
+        return fields;
+    }
+
+   private:
+    vector<string> names;                 // Document paths indexed by document ID
+    unordered_map<string, int> ids;       // Document path to document ID
+    vector<long long> published;          // Publication time (seconds since epoch, UTC) per document ID
+    vector<double> staticScores;          // Query-independent quality prior in [0, 1] per document ID
+    vector<FacetColumn> facets = vector<FacetColumn>(facetFields().size());  // One column per facet field
+
+    // Document IDs sorted by publication time, rebuilt lazily after documents change
+    mutable vector<int> byPublished;
+    mutable bool byPublishedDirty = true;
+
+    // Whether document IDs are in descending static-score order, checked lazily after changes
+    mutable bool staticOrderDirty = true;
+    mutable bool staticOrdered = true;
+
+    // Incremented whenever existing documents may get different IDs, so ID-keyed caches can detect it
+    size_t numbering = 0;
+
+    /**
+     * @brief Converts a civil date to the number of days since 1970-01-01.
+     */
+    static long long daysFromCivil(long long y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const long long era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<long long>(doe) - 719468;
+    }
+
+    /**
+     * @brief Reads a fixed-width run of digits from a string.
+     * @return The parsed value, or -1 if the characters are not all digits.
+     */
+    static int readDigits(const string& text, size_t pos, size_t count) {
+        if (pos + count > text.size()) {
+            return -1;
+        }
+        int value = 0;
+        for (size_t i = pos; i < pos + count; ++i) {
+            if (!isdigit(static_cast<unsigned char>(text[i]))) {
+                return -1;
+            }
+            value = value * 10 + (text[i] - '0');
+        }
+        return value;
+    }
+
+    /**
+     * @brief Parses a whole field as an integer, leaving `value` unchanged if it is malformed.
+     */
+    static bool parseNumber(const string& field, long long& value) {
+        char* end = nullptr;
+        errno = 0;
+        long long parsed = strtoll(field.c_str(), &end, 10);
+        if (field.empty() || *end != '\0' || errno == ERANGE) {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+    /**
+     * @brief Parses a whole field as a floating-point number, leaving `value` unchanged if it is malformed.
+     */
+    static bool parseNumber(const string& field, double& value) {
+        char* end = nullptr;
+        double parsed = strtod(field.c_str(), &end);
+        if (field.empty() || *end != '\0') {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+   public:
+    // Marker for a document or query bound without a usable timestamp
+    static constexpr long long NO_TIMESTAMP = -(1LL << 62);
+
+    /**
+     * @brief Parses an ISO-8601 timestamp such as "2018-02-27T20:09:00.000+02:00"
+     *        or a plain date such as "2018-02-27" into seconds since the epoch (UTC).
+     * @param text The timestamp text.
+     * @return The timestamp, or NO_TIMESTAMP if the text cannot be parsed.
+     */
+    static long long parseTimestamp(const string& text) {
+        int year = readDigits(text, 0, 4);
+        int month = readDigits(text, 5, 2);
+        int day = readDigits(text, 8, 2);
+        if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31) {
+            return NO_TIMESTAMP;
+        }
+
+        long long seconds = daysFromCivil(year, month, day) * 86400;
+        if (text.size() < 19 || (text[10] != 'T' && text[10] != ' ')) {
+            return seconds;
+        }
+
+        int hour = readDigits(text, 11, 2);
+        int minute = readDigits(text, 14, 2);
+        int second = readDigits(text, 17, 2);
+        if (hour < 0 || minute < 0 || second < 0) {
+            return seconds;
+        }
+        seconds += hour * 3600 + minute * 60 + second;
+
+        // Apply a trailing "+HH:MM" / "-HH:MM" offset so every column value is UTC
+        size_t zone = text.find_first_of("+-", 19);
+        if (zone != string::npos) {
+            int offsetHours = readDigits(text, zone + 1, 2);
+            int offsetMinutes = readDigits(text, zone + 4, 2);
+            if (offsetHours >= 0 && offsetMinutes >= 0) {
+                long long offset = offsetHours * 3600 + offsetMinutes * 60;
+                seconds += text[zone] == '+' ? -offset : offset;
+            }
+        }
+        return seconds;
+    }
+
+    /**
+     * @brief Returns the ID for a document, assigning the next free ID if it is new.
+     * @param documentName The path of the document.
+     * @return The document ID.
+     */
+    int addDocument(const string& documentName) {
+        auto found = ids.find(documentName);
+        if (found != ids.end()) {
+            return found->second;
+        }
+        int docID = static_cast<int>(names.size());
+        ids.emplace(documentName, docID);
+        names.push_back(documentName);
+        published.push_back(NO_TIMESTAMP);
+        staticScores.push_back(0.0);
+        staticOrderDirty = true;
+        for (auto& column : facets) {
+            column.starts.push_back(static_cast<uint32_t>(column.values.size()));
+        }
+        byPublishedDirty = true;
+        return docID;
+    }
+
+    /**
+     * @brief Looks up the ID of a document.
+     * @param documentName The path of the document.
+     * @return The document ID, or -1 if the document is not in the table.
+     */
+    int getID(const string& documentName) const {
+        auto found = ids.find(documentName);
+        return found == ids.end() ? -1 : found->second;
+    }
+
+    /**
+     * @brief Returns the path of the document with the given ID.
+     */
+    const string& getName(int docID) const {
+        return names[docID];
+    }
+
+    /**
+     * @brief Stores the publication timestamp of a document.
+     */
+    void setPublished(int docID, long long timestamp) {
+        published[docID] = timestamp;
+        byPublishedDirty = true;
+    }
+
+    /**
+     * @brief Returns the publication timestamp of a document, or NO_TIMESTAMP.
+     */
+    long long getPublished(int docID) const {
+        return published[docID];
+    }
+
+    /**
+     * @brief Combines thread.domain_rank and thread.spam_score into a quality prior in [0, 1].
+     *        Better-ranked domains (smaller rank) score higher, and the spam probability
+     *        scales the result down. A missing rank (0) counts as a mid-ranked domain.
+     * @param domainRank The site's traffic rank, or 0 if unknown.
+     * @param spamScore The probability that the article is spam, in [0, 1].
+     * @return The static score.
+     */
+    static double computeStaticScore(long long domainRank, double spamScore) {
+        double rankScore = domainRank > 0 ? 1.0 / (1.0 + log10(static_cast<double>(domainRank))) : 0.2;
+        return rankScore * (1.0 - min(max(spamScore, 0.0), 1.0));
+    }
+
+    /**
+     * @brief Stores the static quality score of a document.
+     */
+    void setStaticScore(int docID, double score) {
+        staticScores[docID] = score;
+        staticOrderDirty = true;
+    }
+
+    /**
+     * @brief Checks whether document IDs are in descending static-score order, as left by
+     *        reorderByStaticScore. Documents added afterwards may break the order.
+     */
+    bool isStaticOrdered() const {
+        if (staticOrderDirty) {
+            staticOrdered = is_sorted(staticScores.begin(), staticScores.end(), greater<double>());
+            staticOrderDirty = false;
+        }
+        return staticOrdered;
+    }
+
+    /**
+     * @brief Returns the static quality score of a document.
+     */
+    double getStaticScore(int docID) const {
+        return staticScores[docID];
+    }
+
+    /**
+     * @brief Renumbers documents in descending static-score order, so a lower document ID
+     *        always means a document of at least the same quality. Ranking relies on this
+     *        order to stop scanning once no remaining document can enter the top results.
+     */
+    void reorderByStaticScore() {
+        vector<int> order(names.size());
+        for (size_t docID = 0; docID < order.size(); ++docID) {
+            order[docID] = static_cast<int>(docID);
+        }
+        stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return staticScores[a] > staticScores[b];
+        });
+        applyOrder(order);
+    }
+
+    /**
+     * @brief Renumbers documents so that the document with old ID order[i] gets ID i,
+     *        permuting every column to match.
+     * @param order A permutation of all current document IDs.
+     */
+    void applyOrder(const vector<int>& order) {
+        vector<string> oldNames;
+        oldNames.swap(names);
+        vector<long long> oldPublished;
+        oldPublished.swap(published);
+        vector<double> oldScores;
+        oldScores.swap(staticScores);
+        vector<FacetColumn> oldFacets(facets.size());
+        for (size_t f = 0; f < facets.size(); ++f) {
+            oldFacets[f].values.swap(facets[f].values);
+            oldFacets[f].starts.swap(facets[f].starts);
+            facets[f].starts.assign(1, 0);
+        }
+
+        ids.clear();
+        for (int oldID : order) {
+            ids[oldNames[oldID]] = static_cast<int>(names.size());
+            names.push_back(oldNames[oldID]);
+            published.push_back(oldPublished[oldID]);
+            staticScores.push_back(oldScores[oldID]);
+            for (size_t f = 0; f < facets.size(); ++f) {
+                const FacetColumn& old = oldFacets[f];
+                facets[f].values.insert(facets[f].values.end(), old.values.begin() + old.starts[oldID],
+                                        old.values.begin() + old.starts[oldID + 1]);
+                facets[f].starts.push_back(static_cast<uint32_t>(facets[f].values.size()));
+            }
+        }
+        byPublishedDirty = true;
+        staticOrderDirty = true;
+        ++numbering;
+    }
+
+    /**
+     * @brief Returns a counter that changes whenever documents are renumbered or the table is cleared.
+     */
+    size_t getNumbering() const {
+        return numbering;
+    }
+
+    /**
+     * @brief Returns the column for a facet field, or nullptr if the field is not a facet.
+     */
+    const FacetColumn* getFacet(const string& field) const {
+        auto found = find(facetFields().begin(), facetFields().end(), field);
+        return found == facetFields().end() ? nullptr : &facets[found - facetFields().begin()];
+    }
+
+    /**
+     * @brief Adds a value to a facet field of a document. Values can only be added to
+     *        the most recently added document, which is how the parser fills the table.
+     * @param docID The document ID.
+     * @param field One of facetFields().
+     * @param value The value; empty values and values the document already has are ignored.
+     */
+    void addFacetValue(int docID, const string& field, string value) {
+        auto found = find(facetFields().begin(), facetFields().end(), field);
+        if (found == facetFields().end() || value.empty() || docID + 1 != static_cast<int>(names.size())) {
+            return;
+        }
+
+        // Tabs, newlines and '|' delimit the persisted table, so they cannot appear in values
+        replace_if(value.begin(), value.end(), [](char ch) { return ch == '\t' || ch == '\n' || ch == '|'; }, ' ');
+
+        FacetColumn& column = facets[found - facetFields().begin()];
+        auto code = column.codes.find(value);
+        if (code == column.codes.end()) {
+            code = column.codes.emplace(value, static_cast<uint32_t>(column.dictionary.size())).first;
+            column.dictionary.push_back(value);
+        }
+        // A value listed twice in one document (e.g. a repeated organization entity) counts once
+        if (find(column.values.begin() + column.starts[docID], column.values.end(), code->second) !=
+            column.values.end()) {
+            return;
+        }
+        column.values.push_back(code->second);
+        ++column.starts.back();
+    }
+
+    /**
+     * @brief Returns the most recent publication timestamp, or NO_TIMESTAMP if no document has one.
+     */
+    long long getLatestPublished() const {
+        long long latest = NO_TIMESTAMP;
+        for (long long timestamp : published) {
+            latest = max(latest, timestamp);
+        }
+        return latest;
+    }
+
+    /**
+     * @brief Builds the lazily computed publication index and static-order flag now, so that
+     *        several threads can afterwards read the table without any of them writing to it.
+     */
+    void prepareForConcurrentReads() const {
+        isStaticOrdered();
+        publishedBetween(0, 0);
+    }
+
+    /**
+     * @brief Builds a docID-ordered bitset of the documents published in [from, to].
+     *        Uses the sorted publication column, so the cost is two binary searches
+     *        plus one bit per matching document.
+     * @param from Inclusive lower bound in seconds since the epoch.
+     * @param to Inclusive upper bound in seconds since the epoch.
+     * @return A bitset indexed by document ID.
+     */
+    vector<bool> publishedBetween(long long from, long long to) const {
+        if (byPublishedDirty) {
+            byPublished.clear();
+            for (int docID = 0; docID < static_cast<int>(names.size()); ++docID) {
+                if (published[docID] != NO_TIMESTAMP) {
+                    byPublished.push_back(docID);
+                }
+            }
+            sort(byPublished.begin(), byPublished.end(), [this](int a, int b) {
+                return published[a] < published[b];
+            });
+            byPublishedDirty = false;
+        }
+
+        vector<bool> inRange(names.size(), false);
+        auto first = lower_bound(byPublished.begin(), byPublished.end(), from,
+                                 [this](int docID, long long value) { return published[docID] < value; });
+        auto last = upper_bound(byPublished.begin(), byPublished.end(), to,
+                                [this](long long value, int docID) { return value < published[docID]; });
+        for (auto it = first; it < last; ++it) {
+            inRange[*it] = true;
+        }
+        return inRange;
+    }
+
+    /**
+     * @brief Returns the number of documents in the table.
+     */
+    size_t getSize() const {
+        return names.size();
+    }
+
+    /**
+     * @brief Estimates the heap memory held by the table.
+     */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.nameBytes = MemoryAccounting::allocationBytes(names.capacity() * sizeof(string));
+        for (const auto& name : names) {
+            usage.nameBytes += 2 * MemoryAccounting::stringHeapBytes(name);  // Stored again as the ids key
+        }
+        usage.idIndexBytes = MemoryAccounting::unorderedMapBytes(ids);
+        usage.columnBytes = MemoryAccounting::allocationBytes(published.capacity() * sizeof(long long)) +
+                            MemoryAccounting::allocationBytes(staticScores.capacity() * sizeof(double)) +
+                            MemoryAccounting::allocationBytes(byPublished.capacity() * sizeof(int));
+        for (const auto& facet : facets) {
+            usage.facetBytes += MemoryAccounting::allocationBytes(facet.dictionary.capacity() * sizeof(string)) +
+                                MemoryAccounting::unorderedMapBytes(facet.codes) +
+                                MemoryAccounting::allocationBytes(facet.starts.capacity() * sizeof(uint32_t)) +
+                                MemoryAccounting::allocationBytes(facet.values.capacity() * sizeof(uint32_t));
+            for (const auto& value : facet.dictionary) {
+                usage.facetBytes += 2 * MemoryAccounting::stringHeapBytes(value);  // Stored again as the codes key
+            }
+        }
+        return usage;
+    }
+
+    /**
+     * @brief Clears all documents from the table.
+     */
+    void makeEmpty() {
+        names.clear();
+        ids.clear();
+        published.clear();
+        staticScores.clear();
+        facets.assign(facetFields().size(), FacetColumn());
+        byPublished.clear();
+        byPublishedDirty = true;
+        staticOrderDirty = true;
+        ++numbering;
+    }
+
+    /**
+     * @brief Writes the table to a text file, one line per document ID:
+     *        "published<TAB>staticScore<TAB>site<TAB>author<TAB>org1|org2<TAB>path".
+     * @param filename The name of the file to write to.
+     */
+    void writeToTextFile(const string& filename) const {
+        ofstream outFile(filename);
+        if (!outFile) {
+            cerr << "Error: Unable to open file " << filename << " for writing." << endl;
+            return;
+        }
+        for (size_t docID = 0; docID < names.size(); ++docID) {
+            outFile << published[docID] << '\t' << staticScores[docID] << '\t';
+            for (const auto& column : facets) {
+                for (uint32_t i = column.starts[docID]; i < column.starts[docID + 1]; ++i) {
+                    outFile << (i > column.starts[docID] ? "|" : "") << column.dictionary[column.values[i]];
+                }
+                outFile << '\t';
+            }
+            outFile << names[docID] << '\n';
+        }
+        outFile.close();
+    }
+
+    /**
+     * @brief Reads a table written by writeToTextFile, replacing the current contents.
+     *        A malformed date falls back to NO_TIMESTAMP, and a malformed score to 0.
+     * @param filename The name of the file to read from.
+     */
+    void readFromTextFile(const string& filename) {
+        ifstream inFile(filename);
+        if (!inFile) {
+            cerr << "Error: Unable to open file " << filename << " for reading." << endl;
+            return;
+        }
+
+        makeEmpty();
+        string line;
+        while (getline(inFile, line)) {
+            vector<string> fields;
+            size_t start = 0;
+            for (size_t tabPos; fields.size() < facets.size() + 2 && (tabPos = line.find('\t', start)) != string::npos;) {
+                fields.push_back(line.substr(start, tabPos - start));
+                start = tabPos + 1;
+            }
+            if (fields.size() < 2) {
+                cerr << "Error: Invalid file format. Tab not found." << endl;
+                continue;
+            }
+
+            // The path is always the last field; facet fields sit between it and the static score
+            int docID = addDocument(line.substr(start));
+            long long timestamp = NO_TIMESTAMP;
+            if (!parseNumber(fields[0], timestamp)) {
+                cerr << "Error: Invalid publication date for " << names[docID] << ": " << fields[0] << endl;
+            }
+            setPublished(docID, timestamp);
+            double score = 0.0;
+            if (!parseNumber(fields[1], score)) {
+                cerr << "Error: Invalid static score for " << names[docID] << ": " << fields[1] << endl;
+            }
+            setStaticScore(docID, score);
+            for (size_t f = 2; f < fields.size(); ++f) {
+                size_t valueStart = 0;
+                while (valueStart <= fields[f].size()) {
+                    size_t bar = fields[f].find('|', valueStart);
+                    if (bar == string::npos) {
+                        bar = fields[f].size();
+                    }
+                    addFacetValue(docID, facetFields()[f - 2], fields[f].substr(valueStart, bar - valueStart));
+                    valueStart = bar + 1;
+                }
+            }
+        }
+        inFile.close();
+    }
+};
+
+#endif  // DOCUMENT_TABLE_H
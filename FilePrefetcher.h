@@ -0,0 +1,313 @@
+#ifndef FILE_PREFETCHER_H
+#define FILE_PREFETCHER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "DirectoryWalker.h"
+#include "GzipFile.h"
+
+using namespace std;
+
+/**
+ * @class FilePrefetcher
+ * @brief An I/O stage between the directory walker and the parser: files are read whole into
+ * pooled buffers on reader threads, so parser threads get documents from memory and never wait
+ * on disk. A hint thread takes files from the walker in windows, optionally sorts each window
+ * by inode number (on ext4 and XFS a proxy for on-disk position), and on Linux opens each file
+ * with posix_fadvise(WILLNEED), which starts the kernel's readahead while earlier files are
+ * still being read. Gzip files are decompressed on the reader threads. Files the caller streams
+ * itself (e.g. JSON Lines dumps) are passed through unread. Whatever order files are read in,
+ * they are handed out in walk order: each gets a sequence number, and finished files wait in a
+ * reorder buffer until their turn.
+ */
+class FilePrefetcher {
+   public:
+    // Files hinted ahead of the readers
+    static constexpr size_t DEFAULT_WINDOW = 64;
+
+    // Reader threads; they mostly wait on the disk, so more threads than cores can help
+    static constexpr size_t DEFAULT_READ_THREADS = 4;
+
+    /**
+     * @struct File
+     * @brief A file from the walk; `content` holds it whole unless it was passed through.
+     */
+    struct File {
+        string path;
+        bool passedThrough = false;  // True for files left for the caller to read
+        bool loaded = false;         // True if `content` holds the file
+        string content;
+    };
+
+   private:
+    /**
+     * @struct HintedFile
+     * @brief A file opened and hinted, waiting for a reader.
+     */
+    struct HintedFile {
+        uint64_t sequence;  // Position in walk order
+        string path;
+        int fd;  // -1 for gzip files, which GzipFile opens itself, and off Linux
+    };
+
+    DirectoryWalker& walker;
+    function<bool(const string&)> passThrough;
+    size_t window;
+    bool orderByInode;
+
+    mutex lock;
+    condition_variable hintedAvailable;  // A file was hinted, or the hints are done
+    condition_variable roomAvailable;    // The consumer took a file, so another may be hinted
+    condition_variable readyAvailable;   // A file is ready, or everything was hinted
+    deque<HintedFile> hinted;
+    map<uint64_t, File> ready;  // Reorder buffer: read files by sequence number
+    vector<string> pool;        // Buffers returned by the consumer, reused by the readers
+    uint64_t sequenceCount = 0; // Files taken from the walker
+    uint64_t nextSequence = 0;  // The next file to hand out
+    bool hintsDone = false;
+    bool stopping = false;
+    vector<thread> threads;
+
+    /**
+     * @brief Returns the files hinted, being read or waiting to be handed out. At most two
+     *        windows are, so readers never wait for room and the next file can always be read.
+     */
+    uint64_t filesInFlight() const {
+        return sequenceCount - nextSequence;
+    }
+
+    /**
+     * @brief Reads a whole file into `content`, reusing its capacity.
+     */
+    static bool readWhole(const HintedFile& file, string& content) {
+        if (GzipFile::isGzipFile(file.path)) {
+            return GzipFile::readAll(file.path, content);
+        }
+#ifdef __linux__
+        if (file.fd < 0) {
+            return false;
+        }
+        struct stat status;
+        size_t expected = fstat(file.fd, &status) == 0 && status.st_size > 0 ? status.st_size : 0;
+        content.resize(max<size_t>(expected, 1 << 12));
+        size_t length = 0;
+        while (true) {
+            if (length == content.size()) {
+                content.resize(content.size() * 2);  // The file grew, or its size was unknown
+            }
+            ssize_t count = read(file.fd, &content[length], content.size() - length);
+            if (count < 0) {
+                return false;
+            }
+            if (count == 0) {
+                break;
+            }
+            length += count;
+        }
+        content.resize(length);
+        return true;
+#else
+        ifstream input(file.path, ios::binary);
+        if (!input.is_open()) {
+            return false;
+        }
+        content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+        return true;
+#endif
+    }
+
+    static void closeFile(const HintedFile& file) {
+#ifdef __linux__
+        if (file.fd >= 0) {
+            close(file.fd);
+        }
+#else
+        (void)file;
+#endif
+    }
+
+    /**
+     * @brief The hint thread: takes windows of files from the walker, numbers them in walk order,
+     *        opens and hints them in inode order, and queues them for the readers.
+     */
+    void hint() {
+        vector<HintedFile> batch;
+        vector<uint64_t> inodes;
+        bool more = true;
+        while (more) {
+            batch.clear();
+            inodes.clear();
+            DirectoryWalker::FoundFile found;
+            while (batch.size() < window && (more = walker.next(found))) {
+                batch.push_back({sequenceCount + batch.size(), move(found.path), -1});
+                inodes.push_back(found.inode);
+            }
+            {
+                lock_guard<mutex> guard(lock);
+                sequenceCount += batch.size();  // Counted in flight from here, so the window bound holds
+            }
+            vector<size_t> order(batch.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            if (orderByInode) {
+                stable_sort(order.begin(), order.end(), [&inodes](size_t a, size_t b) { return inodes[a] < inodes[b]; });
+            }
+            for (size_t i : order) {
+                HintedFile& file = batch[i];
+                if (passThrough(file.path)) {
+                    lock_guard<mutex> guard(lock);
+                    ready[file.sequence] = {move(file.path), true, false, string()};
+                    readyAvailable.notify_one();
+                    continue;
+                }
+#ifdef __linux__
+                if (!GzipFile::isGzipFile(file.path)) {
+                    file.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_WILLNEED
+                    if (file.fd >= 0) {
+                        posix_fadvise(file.fd, 0, 0, POSIX_FADV_WILLNEED);
+                    }
+#endif
+                }
+#endif
+                lock_guard<mutex> guard(lock);
+                hinted.push_back(move(file));
+                hintedAvailable.notify_one();
+            }
+            // The next window is taken once the consumer is within a window of this one
+            unique_lock<mutex> guard(lock);
+            roomAvailable.wait(guard, [this] { return stopping || filesInFlight() < window; });
+            if (stopping) {
+                return;
+            }
+        }
+        lock_guard<mutex> guard(lock);
+        hintsDone = true;
+        hintedAvailable.notify_all();
+        readyAvailable.notify_all();
+    }
+
+    /**
+     * @brief A reader thread: reads hinted files into pooled buffers and files them in the reorder buffer.
+     */
+    void readFiles() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            hintedAvailable.wait(guard, [this] { return stopping || !hinted.empty() || hintsDone; });
+            if (stopping || hinted.empty()) {
+                return;
+            }
+            HintedFile file = move(hinted.front());
+            hinted.pop_front();
+            File result;
+            if (!pool.empty()) {
+                result.content = move(pool.back());
+                pool.pop_back();
+            }
+            guard.unlock();
+
+            result.loaded = readWhole(file, result.content);
+            closeFile(file);
+            result.path = move(file.path);
+
+            guard.lock();
+            if (stopping) {
+                return;
+            }
+            ready[file.sequence] = move(result);
+            readyAvailable.notify_one();
+        }
+    }
+
+   public:
+    /**
+     * @brief Starts prefetching the files the walker finds.
+     * @param files The walk to take files from; it must outlive the prefetcher.
+     * @param skipReading Returns true for files to pass through unread.
+     * @param windowFiles Files hinted ahead of the readers; at most two windows are held at once.
+     * @param sortByInode True to read each window in inode order.
+     * @param readThreads Reader threads; 0 is treated as 1.
+     */
+    FilePrefetcher(DirectoryWalker& files, function<bool(const string&)> skipReading,
+                   size_t windowFiles = DEFAULT_WINDOW, bool sortByInode = false,
+                   size_t readThreads = DEFAULT_READ_THREADS)
+        : walker(files), passThrough(move(skipReading)), window(max<size_t>(1, windowFiles)),
+          orderByInode(sortByInode) {
+        threads.emplace_back(&FilePrefetcher::hint, this);
+        for (size_t reader = 0; reader < max<size_t>(1, readThreads); ++reader) {
+            threads.emplace_back(&FilePrefetcher::readFiles, this);
+        }
+    }
+
+    /**
+     * @brief Stops prefetching if the consumer did not take every file, and waits for the threads.
+     */
+    ~FilePrefetcher() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        hintedAvailable.notify_all();
+        roomAvailable.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& file : hinted) {
+            closeFile(file);
+        }
+    }
+
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    /**
+     * @brief Takes the next file in walk order, waiting until it has been read.
+     * @param file Filled with the file; hand its content back with recycle() when done.
+     * @return False once every file has been returned.
+     */
+    bool next(File& file) {
+        unique_lock<mutex> guard(lock);
+        readyAvailable.wait(guard, [this] {
+            return ready.count(nextSequence) > 0 || (hintsDone && nextSequence == sequenceCount);
+        });
+        auto found = ready.find(nextSequence);
+        if (found == ready.end()) {
+            return false;
+        }
+        file = move(found->second);
+        ready.erase(found);
+        ++nextSequence;
+        roomAvailable.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Returns a file's buffer to the pool, so a later file is read into its memory.
+     */
+    void recycle(string&& buffer) {
+        lock_guard<mutex> guard(lock);
+        if (pool.size() < window) {
+            pool.push_back(move(buffer));
+        }
+    }
+};
+
+#endif  // FILE_PREFETCHER_H
@@ -0,0 +1,310 @@
+#ifndef GZIP_FILE_H
+#define GZIP_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef SUPERSEARCH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+/**
+ * @class GzipFile
+ * @brief Streams the decompressed bytes of a gzip file with zlib's inflate, reading the
+ * compressed file through one reusable input buffer. Files made of several gzip members
+ * (e.g. from pigz or appended dumps) are read as one stream. While a file is read, seek points
+ * can be recorded at deflate block boundaries, and a later reader can restart decompression at
+ * one of them instead of at the start of the file (the technique of zlib's zran example).
+ * Support is compiled in when
+ * CMake finds zlib (SUPERSEARCH_HAVE_ZLIB); otherwise opening a file reports that gzip input
+ * is unavailable.
+ */
+class GzipFile {
+   public:
+    // Compressed bytes read from the file at a time
+    static constexpr size_t INPUT_BUFFER_BYTES = 1 << 20;
+
+    // Output a deflate block may refer back to, kept with each seek point
+    static constexpr size_t WINDOW_BYTES = 32768;
+
+    /**
+     * @struct SeekPoint
+     * @brief A deflate block boundary where decompression can restart.
+     */
+    struct SeekPoint {
+        uint64_t output = 0;  // Decompressed offset of the boundary
+        uint64_t input = 0;   // Compressed offset of the first whole byte after the boundary
+        int bits = 0;         // Bits of the byte before `input` that belong to the next block
+        string window;        // Up to WINDOW_BYTES of output before the boundary
+    };
+
+   private:
+    ifstream input;
+    string filePath;
+    bool open = false;
+    bool finished = false;
+    bool failed = false;
+#ifdef SUPERSEARCH_HAVE_ZLIB
+    vector<unsigned char> compressed;
+    z_stream stream = {};
+    bool memberEnded = false;  // A member just ended; bytes after it start another member or are padding
+    bool rawMember = false;    // Resumed at a seek point: the member's deflate data, without its header
+    size_t trailerLeft = 0;    // Bytes of a resumed member's gzip trailer still to skip
+    uint64_t inputBytes = 0;   // Compressed bytes read from the file
+    uint64_t outputBytes = 0;  // Decompressed bytes returned
+    vector<SeekPoint>* seekPoints = nullptr;
+    size_t seekSpacing = 0;
+
+    /**
+     * @brief Records a seek point if inflate stopped at a block boundary far enough past the last
+     *        point. The boundary must not end the member's last block: the next member's header
+     *        follows that one.
+     * @param produced Bytes the current read produced so far.
+     */
+    void addSeekPoint(size_t produced) {
+        if ((stream.data_type & 128) == 0 || (stream.data_type & 64) != 0) {
+            return;
+        }
+        uint64_t output = outputBytes + produced;
+        if (output < (seekPoints->empty() ? 0 : seekPoints->back().output) + seekSpacing) {
+            return;
+        }
+        SeekPoint point;
+        point.output = output;
+        point.input = inputBytes - stream.avail_in;
+        point.bits = stream.data_type & 7;
+        point.window.resize(WINDOW_BYTES);
+        uInt length = static_cast<uInt>(point.window.size());
+        if (inflateGetDictionary(&stream, reinterpret_cast<Bytef*>(&point.window[0]), &length) != Z_OK) {
+            return;
+        }
+        point.window.resize(length);
+        seekPoints->push_back(move(point));
+    }
+#endif
+
+    void fail(const string& reason) {
+        cerr << "Error: " << reason << " in " << filePath << endl;
+        failed = true;
+        finished = true;
+    }
+
+   public:
+    explicit GzipFile(const string& path) : input(path, ios::binary), filePath(path) {
+        if (!input.is_open()) {
+            return;
+        }
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        compressed.resize(INPUT_BUFFER_BYTES);
+        // 16 + MAX_WBITS: expect a gzip header and trailer rather than a raw zlib stream
+        open = inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK;
+#else
+        cerr << "Error: " << path << " is gzip-compressed, but this build has no zlib support." << endl;
+#endif
+    }
+
+    ~GzipFile() {
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        if (open) {
+            inflateEnd(&stream);
+        }
+#endif
+    }
+
+    GzipFile(const GzipFile&) = delete;
+    GzipFile& operator=(const GzipFile&) = delete;
+
+    /**
+     * @brief Returns true if this build can read gzip files.
+     */
+    static constexpr bool isSupported() {
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Returns true for files read through gzip (.gz).
+     */
+    static bool isGzipFile(const string& path) {
+        return filesystem::path(path).extension() == ".gz";
+    }
+
+    bool isOpen() const {
+        return open;
+    }
+
+    /**
+     * @brief Returns true if the file was truncated or corrupt.
+     */
+    bool hasError() const {
+        return failed;
+    }
+
+    /**
+     * @brief Records a seek point about every `spacing` decompressed bytes while the file is
+     *        read. Inflate then stops at every block boundary, which costs a little speed.
+     * @param points Receives the points; it must outlive the reads.
+     * @param spacing The fewest decompressed bytes between two points.
+     */
+    void recordSeekPoints(vector<SeekPoint>& points, size_t spacing) {
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        seekPoints = &points;
+        seekSpacing = max<size_t>(spacing, 1);
+#else
+        (void)points;
+        (void)spacing;
+#endif
+    }
+
+    /**
+     * @brief Restarts decompression at a seek point recorded from the same file. Call it before
+     *        reading; the next read returns the bytes from `point.output` on.
+     * @return False if the file cannot be positioned there.
+     */
+    bool seek(const SeekPoint& point) {
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        if (!open || inputBytes > 0 || outputBytes > 0) {
+            return false;
+        }
+        // Resumed data has no gzip header, so the rest of this member is inflated as raw deflate
+        input.seekg(static_cast<streamoff>(point.input - (point.bits > 0 ? 1 : 0)));
+        if (!input || inflateReset2(&stream, -MAX_WBITS) != Z_OK) {
+            fail("Cannot seek in gzip data");
+            return false;
+        }
+        if (point.bits > 0) {
+            int byte = input.get();
+            if (byte == EOF || inflatePrime(&stream, point.bits, byte >> (8 - point.bits)) != Z_OK) {
+                fail("Cannot seek in gzip data");
+                return false;
+            }
+        }
+        if (!point.window.empty() &&
+            inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(point.window.data()),
+                                 static_cast<uInt>(point.window.size())) != Z_OK) {
+            fail("Cannot seek in gzip data");
+            return false;
+        }
+        rawMember = true;
+        inputBytes = point.input;
+        outputBytes = point.output;
+        return true;
+#else
+        (void)point;
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Decompresses up to `size` bytes.
+     * @param out Where to write the decompressed bytes.
+     * @param size Room in `out`.
+     * @return The bytes written; 0 at the end of the file or after an error.
+     */
+    size_t read(char* out, size_t size) {
+        if (!open || finished) {
+            return 0;
+        }
+#ifdef SUPERSEARCH_HAVE_ZLIB
+        stream.next_out = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = static_cast<uInt>(size);
+        while (stream.avail_out > 0 && !finished) {
+            if (stream.avail_in == 0) {
+                input.read(reinterpret_cast<char*>(compressed.data()), compressed.size());
+                size_t count = static_cast<size_t>(input.gcount());
+                if (count == 0) {
+                    if (!memberEnded) {
+                        fail("Truncated gzip data");
+                    }
+                    finished = true;
+                    break;
+                }
+                stream.next_in = compressed.data();
+                stream.avail_in = static_cast<uInt>(count);
+                inputBytes += count;
+            }
+            if (trailerLeft > 0) {
+                size_t skipped = min<size_t>(trailerLeft, stream.avail_in);
+                stream.next_in += skipped;
+                stream.avail_in -= static_cast<uInt>(skipped);
+                trailerLeft -= skipped;
+                continue;
+            }
+            int status = inflate(&stream, seekPoints != nullptr ? Z_BLOCK : Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                memberEnded = true;
+                if (rawMember) {
+                    // Raw deflate stops before the member's CRC and length; later members have headers again
+                    rawMember = false;
+                    trailerLeft = 8;
+                    inflateReset2(&stream, 16 + MAX_WBITS);
+                } else {
+                    inflateReset(&stream);
+                }
+            } else if (status == Z_OK) {
+                memberEnded = false;
+                if (seekPoints != nullptr) {
+                    addSeekPoint(size - stream.avail_out);
+                }
+            } else if (status == Z_DATA_ERROR && memberEnded) {
+                finished = true;  // Padding after the last member, as some archivers write
+            } else if (status != Z_BUF_ERROR) {
+                fail(stream.msg != nullptr ? string("Corrupt gzip data (") + stream.msg + ")" : "Corrupt gzip data");
+            }
+        }
+        outputBytes += size - stream.avail_out;
+        return size - stream.avail_out;
+#else
+        (void)out;
+        (void)size;
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Decompresses and discards `bytes` bytes, e.g. to reach a record offset.
+     * @return False if the file ends first.
+     */
+    bool skip(size_t bytes) {
+        vector<char> scratch(min<size_t>(bytes, 1 << 20));
+        while (bytes > 0) {
+            size_t count = read(scratch.data(), min(bytes, scratch.size()));
+            if (count == 0) {
+                return false;
+            }
+            bytes -= count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads and decompresses a whole file.
+     * @param path The gzip file.
+     * @param content Filled with the decompressed bytes.
+     * @return False if the file cannot be opened or is corrupt.
+     */
+    static bool readAll(const string& path, string& content) {
+        GzipFile file(path);
+        if (!file.isOpen()) {
+            return false;
+        }
+        content.clear();
+        char chunk[1 << 16];
+        for (size_t count; (count = file.read(chunk, sizeof(chunk))) > 0;) {
+            content.append(chunk, count);
+        }
+        return !file.hasError();
+    }
+};
+
+#endif  // GZIP_FILE_H
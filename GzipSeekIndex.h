@@ -0,0 +1,219 @@
+#ifndef GZIP_SEEK_INDEX_H
+#define GZIP_SEEK_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GzipFile.h"
+
+using namespace std;
+
+/**
+ * @class GzipSeekIndex
+ * @brief The seek points of the gzip files indexed record by record (.jsonl.gz dumps). A record
+ * locator into such a dump is read by inflating from the nearest point before the record instead
+ * of from the start of the file. Points are recorded while the dump is indexed, saved with the
+ * index and loaded with it. A file whose size or modification time changed since is read from
+ * its start. The points are process-wide, like the trace buffers, because documents are read by
+ * locator alone.
+ */
+class GzipSeekIndex {
+   public:
+    // Decompressed bytes between seek points; each point keeps a 32 KiB window, about 3% of the spacing
+    static constexpr size_t DEFAULT_SPACING = 1 << 20;
+
+   private:
+    /**
+     * @struct FileEntry
+     * @brief The points of one file and the file's state when they were recorded.
+     */
+    struct FileEntry {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        vector<GzipFile::SeekPoint> points;  // In increasing output order
+    };
+
+    struct State {
+        mutex lock;
+        map<string, FileEntry> files;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    // The file's size and modification time, or zeros if it cannot be read
+    static void fileStamp(const string& filePath, uint64_t& size, int64_t& modified) {
+        error_code error;
+        size = filesystem::file_size(filePath, error);
+        if (error) {
+            size = 0;
+        }
+        auto time = filesystem::last_write_time(filePath, error);
+        modified = error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+    }
+
+    template <typename T>
+    static void writeValue(ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool readValue(ifstream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    static void writeString(ofstream& out, const string& text) {
+        writeValue<uint64_t>(out, text.size());
+        out.write(text.data(), static_cast<streamsize>(text.size()));
+    }
+
+    static bool readString(ifstream& in, string& text) {
+        uint64_t length = 0;
+        if (!readValue(in, length) || length > (uint64_t(1) << 32)) {
+            return false;
+        }
+        text.resize(length);
+        return length == 0 || static_cast<bool>(in.read(&text[0], static_cast<streamsize>(length)));
+    }
+
+   public:
+    /**
+     * @brief Stores the points recorded while reading a whole file, replacing any earlier ones.
+     */
+    static void add(const string& filePath, vector<GzipFile::SeekPoint> points) {
+        FileEntry entry;
+        fileStamp(filePath, entry.size, entry.modified);
+        entry.points = move(points);
+        lock_guard<mutex> guard(state().lock);
+        if (entry.points.empty()) {
+            state().files.erase(filePath);
+        } else {
+            state().files[filePath] = move(entry);
+        }
+    }
+
+    /**
+     * @brief Finds the last point at or before a decompressed offset of a file.
+     * @param point Filled with a copy of the point.
+     * @return False if the file has no point before the offset, or changed since it was indexed.
+     */
+    static bool find(const string& filePath, uint64_t offset, GzipFile::SeekPoint& point) {
+        uint64_t size;
+        int64_t modified;
+        fileStamp(filePath, size, modified);
+        lock_guard<mutex> guard(state().lock);
+        auto file = state().files.find(filePath);
+        if (file == state().files.end() || file->second.size != size || file->second.modified != modified) {
+            return false;
+        }
+        const vector<GzipFile::SeekPoint>& points = file->second.points;
+        auto after = upper_bound(points.begin(), points.end(), offset,
+                                 [](uint64_t value, const GzipFile::SeekPoint& p) { return value < p.output; });
+        if (after == points.begin()) {
+            return false;
+        }
+        point = *(after - 1);
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of points held across all files.
+     */
+    static size_t getPointCount() {
+        lock_guard<mutex> guard(state().lock);
+        size_t count = 0;
+        for (const auto& file : state().files) {
+            count += file.second.points.size();
+        }
+        return count;
+    }
+
+    static void clear() {
+        lock_guard<mutex> guard(state().lock);
+        state().files.clear();
+    }
+
+    /**
+     * @brief Saves the points in a binary file next to the index, or removes a stale file when
+     *        there are none. Integers are written in the machine's byte order.
+     * @return False if the file could not be written.
+     */
+    static bool writeToFile(const string& filename) {
+        lock_guard<mutex> guard(state().lock);
+        if (state().files.empty()) {
+            error_code ignored;
+            filesystem::remove(filename, ignored);
+            return true;
+        }
+        ofstream out(filename, ios::binary);
+        if (!out) {
+            cerr << "Error: Unable to open file " << filename << " for writing." << endl;
+            return false;
+        }
+        writeString(out, "gzip-seek-points 1");
+        writeValue<uint64_t>(out, state().files.size());
+        for (const auto& file : state().files) {
+            writeString(out, file.first);
+            writeValue(out, file.second.size);
+            writeValue(out, file.second.modified);
+            writeValue<uint64_t>(out, file.second.points.size());
+            for (const auto& point : file.second.points) {
+                writeValue(out, point.output);
+                writeValue(out, point.input);
+                writeValue<int32_t>(out, point.bits);
+                writeString(out, point.window);
+            }
+        }
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Loads points saved by writeToFile, replacing the current ones. A missing file
+     *        leaves no points, so every gzip record is read from the start of its file.
+     */
+    static void readFromFile(const string& filename) {
+        clear();
+        ifstream in(filename, ios::binary);
+        if (!in) {
+            return;
+        }
+        map<string, FileEntry> files;
+        string header;
+        uint64_t fileCount = 0;
+        bool valid = readString(in, header) && header == "gzip-seek-points 1" && readValue(in, fileCount);
+        for (uint64_t f = 0; valid && f < fileCount; ++f) {
+            string path;
+            FileEntry entry;
+            uint64_t pointCount = 0;
+            valid = readString(in, path) && readValue(in, entry.size) && readValue(in, entry.modified) &&
+                    readValue(in, pointCount);
+            for (uint64_t p = 0; valid && p < pointCount; ++p) {
+                GzipFile::SeekPoint point;
+                int32_t bits = 0;
+                valid = readValue(in, point.output) && readValue(in, point.input) && readValue(in, bits) &&
+                        readString(in, point.window);
+                point.bits = bits;
+                entry.points.push_back(move(point));
+            }
+            files[path] = move(entry);
+        }
+        if (!valid) {
+            cerr << "Error: Invalid gzip seek points in " << filename << "; compressed records are read from the start."
+                 << endl;
+            return;
+        }
+        lock_guard<mutex> guard(state().lock);
+        state().files = move(files);
+    }
+};
+
+#endif  // GZIP_SEEK_INDEX_H
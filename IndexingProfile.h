@@ -0,0 +1,221 @@
+#ifndef INDEXING_PROFILE_H
+#define INDEXING_PROFILE_H
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "PerfCounters.h"
+
+using namespace std;
+
+/**
+ * @class IndexingProfile
+ * @brief Per-phase time and volume counters for the indexing path, so a run shows which
+ * stage of reading, parsing, analysis or insertion dominates. The parser only reads the
+ * clock when a profile is attached, and each phase is timed once per document. With hardware
+ * counters attached, each phase also accumulates cycles, instructions and cache and branch misses.
+ */
+class IndexingProfile {
+   public:
+    enum Phase { READ, PARSE, TOKENIZE, PUNCTUATION, LOWERCASE, STEM, STOP_WORDS, INSERT, PHASE_COUNT };
+
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * @struct Mark
+     * @brief The clock and counter readings at the start of a phase.
+     */
+    struct Mark {
+        Clock::time_point time;
+        PerfCounters::Counts counts;
+    };
+
+   private:
+    double seconds[PHASE_COUNT] = {};
+    PerfCounters::Counts counters[PHASE_COUNT];
+    const PerfCounters* hardwareCounters = nullptr;
+    size_t documents = 0;
+    size_t bytesRead = 0;
+    size_t tokens = 0;
+    size_t inserts = 0;
+
+   public:
+    /**
+     * @brief Returns the display name of a phase.
+     */
+    static const char* phaseName(Phase phase) {
+        static const char* const names[PHASE_COUNT] = {"read",      "parse", "tokenize",   "punctuation",
+                                                       "lowercase", "stem",  "stop_words", "insert"};
+        return names[phase];
+    }
+
+    /**
+     * @brief Also accumulates hardware counters per phase.
+     * @param perf Counters opened on the indexing thread, or nullptr to stop using them.
+     */
+    void setHardwareCounters(const PerfCounters* perf) {
+        hardwareCounters = perf != nullptr && perf->isAvailable() ? perf : nullptr;
+    }
+
+    /**
+     * @brief Reads the clock (and the counters, if attached) at the start of a phase.
+     */
+    Mark mark() const {
+        Mark start;
+        if (hardwareCounters != nullptr) {
+            start.counts = hardwareCounters->read();
+        }
+        start.time = Clock::now();
+        return start;
+    }
+
+    /**
+     * @brief Adds the time (and counter deltas) since `start` to a phase.
+     */
+    void addPhase(Phase phase, const Mark& start) {
+        seconds[phase] += chrono::duration<double>(Clock::now() - start.time).count();
+        if (hardwareCounters != nullptr) {
+            counters[phase].addDelta(start.counts, hardwareCounters->read());
+        }
+    }
+
+    /**
+     * @brief Counts one document and the bytes read for it.
+     */
+    void addDocument(size_t bytes) {
+        ++documents;
+        bytesRead += bytes;
+    }
+
+    /**
+     * @brief Counts tokens produced by the tokenizer.
+     */
+    void addTokens(size_t count) {
+        tokens += count;
+    }
+
+    /**
+     * @brief Counts tree inserts.
+     */
+    void addInserts(size_t count) {
+        inserts += count;
+    }
+
+    /**
+     * @brief Adds the phases and counters of a profile recorded on another thread. Phase times
+     *        then sum the time of all threads, so they can exceed the wall-clock time.
+     */
+    void merge(const IndexingProfile& other) {
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            seconds[phase] += other.seconds[phase];
+            counters[phase].add(other.counters[phase]);
+        }
+        documents += other.documents;
+        bytesRead += other.bytesRead;
+        tokens += other.tokens;
+        inserts += other.inserts;
+    }
+
+    /**
+     * @brief Returns the seconds spent in a phase.
+     */
+    double getSeconds(Phase phase) const {
+        return seconds[phase];
+    }
+
+    /**
+     * @brief Returns the seconds spent in all phases together.
+     */
+    double getTotalSeconds() const {
+        double total = 0;
+        for (double phaseSeconds : seconds) {
+            total += phaseSeconds;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Prints a per-phase table followed by throughput over the wall-clock time.
+     * @param out The stream to print to.
+     * @param wallSeconds The wall-clock duration of the whole indexing run.
+     */
+    void printTable(ostream& out, double wallSeconds) const {
+        double total = getTotalSeconds();
+        out << left << setw(14) << "phase" << right << setw(12) << "seconds" << setw(9) << "share" << "\n";
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            out << left << setw(14) << phaseName(static_cast<Phase>(phase)) << right << fixed << setprecision(3)
+                << setw(12) << seconds[phase] << setprecision(1) << setw(8)
+                << (total > 0 ? 100.0 * seconds[phase] / total : 0.0) << "%\n";
+        }
+        out << left << setw(14) << "other" << right << setprecision(3) << setw(12)
+            << (wallSeconds > total ? wallSeconds - total : 0.0) << "\n";
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+
+        double seconds = wallSeconds > 0 ? wallSeconds : 1;
+        out << "Documents: " << documents << " (" << documents / seconds << "/s)\n";
+        out << "Bytes read: " << bytesRead << " (" << bytesRead / seconds / (1 << 20) << " MiB/s)\n";
+        out << "Tokens: " << tokens << " (" << tokens / seconds << "/s)\n";
+        out << "Tree inserts: " << inserts << " (" << inserts / seconds << "/s)\n";
+
+        if (hardwareCounters == nullptr) {
+            return;
+        }
+        out << left << setw(14) << "phase" << right;
+        for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+            out << setw(16) << PerfCounters::eventName(static_cast<PerfCounters::Event>(event));
+        }
+        out << setw(7) << "IPC" << "\n";
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            const PerfCounters::Counts& counts = counters[phase];
+            out << left << setw(14) << phaseName(static_cast<Phase>(phase)) << right << fixed << setprecision(0);
+            for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+                if (counts.available[event]) {
+                    out << setw(16) << counts.values[event];
+                } else {
+                    out << setw(16) << "n/a";
+                }
+            }
+            out << setw(7) << setprecision(2) << counts.instructionsPerCycle() << "\n";
+        }
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+    }
+
+    /**
+     * @brief Writes the profile as JSON.
+     * @param out The stream to write to.
+     * @param wallSeconds The wall-clock duration of the whole indexing run.
+     */
+    void writeJson(ostream& out, double wallSeconds) const {
+        out << "{\n  \"wall_seconds\": " << wallSeconds << ",\n  \"phases\": {";
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            out << (phase == 0 ? "\n" : ",\n") << "    \"" << phaseName(static_cast<Phase>(phase))
+                << "\": " << seconds[phase];
+        }
+        out << "\n  },";
+        if (hardwareCounters != nullptr) {
+            out << "\n  \"counters\": {";
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                out << (phase == 0 ? "\n" : ",\n") << "    \"" << phaseName(static_cast<Phase>(phase)) << "\": {";
+                for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+                    out << (event == 0 ? "" : ", ") << "\""
+                        << PerfCounters::eventName(static_cast<PerfCounters::Event>(event)) << "\": ";
+                    if (counters[phase].available[event]) {
+                        out << static_cast<uint64_t>(counters[phase].values[event]);
+                    } else {
+                        out << "null";
+                    }
+                }
+                out << "}";
+            }
+            out << "\n  },";
+        }
+        out << "\n  \"documents\": " << documents << ",\n  \"bytes_read\": " << bytesRead
+            << ",\n  \"tokens\": " << tokens << ",\n  \"inserts\": " << inserts << "\n}\n";
+    }
+};
+
+#endif  // INDEXING_PROFILE_H
@@ -0,0 +1,45 @@
+#ifndef JSON_ESCAPE_H
+#define JSON_ESCAPE_H
+
+#include <string>
+
+using namespace std;
+
+/**
+ * @class JsonEscape
+ * @brief Escaping for the JSON reports written by hand (traces, benchmarks, query explanations).
+ */
+class JsonEscape {
+   public:
+    /**
+     * @brief Escapes a string for a JSON string literal: quotes, backslashes and every control
+     *        character, the common ones by their short form and the rest as \u00XX.
+     */
+    static string escape(const string& text) {
+        static const char* HEX = "0123456789abcdef";
+        string escaped;
+        escaped.reserve(text.size());
+        for (char ch : text) {
+            switch (ch) {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\b': escaped += "\\b"; break;
+                case '\f': escaped += "\\f"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\r': escaped += "\\r"; break;
+                case '\t': escaped += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20) {
+                        escaped += "\\u00";
+                        escaped += HEX[(ch >> 4) & 0xf];
+                        escaped += HEX[ch & 0xf];
+                    } else {
+                        escaped += ch;
+                    }
+            }
+        }
+        return escaped;
+    }
+};
+
+#endif  // JSON_ESCAPE_H
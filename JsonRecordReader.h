@@ -0,0 +1,340 @@
+#ifndef JSON_RECORD_READER_H
+#define JSON_RECORD_READER_H
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GzipFile.h"
+#include "GzipSeekIndex.h"
+
+using namespace std;
+
+/**
+ * @class JsonRecordReader
+ * @brief Streams a file holding many JSON documents, either one per line (JSON Lines) or
+ * concatenated objects, through one large buffer and splits it into records without parsing
+ * them. JSON Lines records end at the next newline, found with memchr. Concatenated records end
+ * at the brace that closes the first one, found by tracking nesting and string literals. A
+ * concatenated file may also be one top-level JSON array of documents: the brackets and commas
+ * between records are skipped like whitespace, so each element is a record. Each
+ * record is identified by a locator "file#offset", the byte offset of its first character, so
+ * results can be displayed later by reading just that record. Gzip files (.jsonl.gz) are
+ * decompressed as they are read; offsets then count decompressed bytes. Reading a whole gzip
+ * file records seek points (GzipSeekIndex), so a record in it is later read by inflating from
+ * the nearest point before it rather than from the start of the file. The next buffer's worth
+ * of the file is read (and inflated) on a worker thread while the current records are parsed.
+ */
+class JsonRecordReader {
+   public:
+    // Bytes read per batch; a record larger than this grows the buffer
+    static constexpr size_t DEFAULT_BUFFER_BYTES = 16 << 20;
+
+    /**
+     * @struct Record
+     * @brief One record in the buffer; the pointer stays valid until the next call to nextBatch.
+     */
+    struct Record {
+        const char* data;
+        size_t length;
+        size_t offset;  // Byte offset of the record in the file
+    };
+
+   private:
+    ifstream input;
+    unique_ptr<GzipFile> gzip;  // Set for gzip files, which are read through it instead of `input`
+    vector<GzipFile::SeekPoint> seekPoints;  // Recorded by `gzip` while a whole file is read
+    bool newlineDelimited;
+    vector<char> buffer;
+    size_t begin = 0;          // First byte of the buffer not yet returned as a record
+    size_t end = 0;            // One past the last byte read into the buffer
+    size_t bufferOffset = 0;   // File offset of buffer[0]
+    bool opened = false;
+    bool atEnd = false;
+    size_t bytesRead = 0;
+
+    // Read-ahead: `pendingRead` fills `filling` on a worker thread while `ready` is consumed.
+    // Declared last, so a read still in flight is waited for before the buffers are destroyed.
+    vector<char> ready;
+    size_t readyLength = 0;
+    size_t readyPosition = 0;
+    vector<char> filling;
+    future<size_t> pendingRead;
+
+    static bool isSpace(char ch) {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    }
+
+    /**
+     * @brief Returns true for bytes skipped between records: whitespace, plus the brackets and
+     *        commas of a top-level array of concatenated documents.
+     */
+    bool isBetweenRecords(char ch) const {
+        return isSpace(ch) || (!newlineDelimited && (ch == '[' || ch == ',' || ch == ']'));
+    }
+
+    /**
+     * @brief Returns the index one past the record starting at `from`, or string::npos if the
+     *        record continues past the bytes read so far.
+     */
+    size_t recordEnd(size_t from) const {
+        if (newlineDelimited) {
+            const char* newline = static_cast<const char*>(memchr(buffer.data() + from, '\n', end - from));
+            return newline == nullptr ? string::npos : newline - buffer.data();
+        }
+        int depth = 0;
+        bool inString = false;
+        for (size_t i = from; i < end; ++i) {
+            char ch = buffer[i];
+            if (inString) {
+                if (ch == '\\') {
+                    ++i;  // Skip the escaped character, which may be a quote
+                } else if (ch == '"') {
+                    inString = false;
+                }
+            } else if (ch == '"') {
+                inString = true;
+            } else if (ch == '{' || ch == '[') {
+                ++depth;
+            } else if ((ch == '}' || ch == ']') && --depth == 0) {
+                return i + 1;
+            }
+        }
+        return string::npos;
+    }
+
+    /**
+     * @brief Reads (and for gzip files, decompresses) the next chunk of the file into `filling`
+     *        on a worker thread.
+     */
+    void startRead() {
+        pendingRead = async(launch::async, [this] {
+            if (gzip != nullptr) {
+                return gzip->read(filling.data(), filling.size());
+            }
+            input.read(filling.data(), filling.size());
+            return static_cast<size_t>(input.gcount());
+        });
+    }
+
+    /**
+     * @brief Copies up to `size` bytes of the file, taking over the read-ahead chunk once the
+     *        current one is used up and starting the next.
+     * @return The bytes copied; 0 at the end of the file.
+     */
+    size_t readChunk(char* out, size_t size) {
+        if (readyPosition == readyLength) {
+            if (!pendingRead.valid()) {
+                return 0;
+            }
+            readyLength = pendingRead.get();
+            readyPosition = 0;
+            swap(ready, filling);
+            if (readyLength == 0) {
+                return 0;
+            }
+            startRead();
+        }
+        size_t count = min(size, readyLength - readyPosition);
+        memcpy(out, ready.data() + readyPosition, count);
+        readyPosition += count;
+        return count;
+    }
+
+    /**
+     * @brief Moves the unconsumed bytes to the front of the buffer and fills the rest from the file.
+     */
+    void refill() {
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        bufferOffset += begin;
+        end -= begin;
+        begin = 0;
+        while (end < buffer.size() && !atEnd) {
+            size_t count = readChunk(buffer.data() + end, buffer.size() - end);
+            end += count;
+            bytesRead += count;
+            atEnd = count == 0;
+        }
+    }
+
+   public:
+    /**
+     * @param filePath The file to read; gzip files (.gz) are decompressed.
+     * @param lineDelimited True for JSON Lines, false for concatenated JSON documents.
+     * @param bufferBytes Bytes read per batch.
+     * @param startOffset Byte offset to start reading from, e.g. the offset in a locator.
+     */
+    JsonRecordReader(const string& filePath, bool lineDelimited, size_t bufferBytes = DEFAULT_BUFFER_BYTES,
+                     size_t startOffset = 0)
+        : newlineDelimited(lineDelimited), buffer(max<size_t>(bufferBytes, 1)), bufferOffset(startOffset),
+          ready(buffer.size()), filling(buffer.size()) {
+        if (GzipFile::isGzipFile(filePath)) {
+            gzip = make_unique<GzipFile>(filePath);
+            if (!gzip->isOpen()) {
+                return;
+            }
+            // Gzip streams cannot seek, so an offset is reached by inflating from the seek point before it
+            GzipFile::SeekPoint point;
+            size_t skipped = 0;
+            if (startOffset == 0) {
+                gzip->recordSeekPoints(seekPoints, GzipSeekIndex::DEFAULT_SPACING);
+            } else if (GzipSeekIndex::find(filePath, startOffset, point)) {
+                if (!gzip->seek(point)) {
+                    return;
+                }
+                skipped = point.output;
+            }
+            if (!gzip->skip(startOffset - skipped)) {
+                return;
+            }
+        } else {
+            input.open(filePath, ios::binary);
+            if (!input.is_open()) {
+                return;
+            }
+            input.seekg(static_cast<streamoff>(startOffset));
+        }
+        opened = true;
+        startRead();
+    }
+
+    /**
+     * @brief Returns true if the file could be opened (and, for gzip, the start offset reached).
+     */
+    bool isOpen() const {
+        return opened;
+    }
+
+    /**
+     * @brief Hands over the seek points recorded while reading a whole gzip file, for
+     *        GzipSeekIndex::add. Call it once nextBatch has returned false.
+     */
+    vector<GzipFile::SeekPoint> takeSeekPoints() {
+        if (pendingRead.valid()) {
+            pendingRead.wait();  // The worker may still be inflating into `seekPoints`
+        }
+        return move(seekPoints);
+    }
+
+    /**
+     * @brief Returns the bytes read from the file so far, after decompression.
+     */
+    size_t getBytesRead() const {
+        return bytesRead;
+    }
+
+    /**
+     * @brief Reads the next buffer of the file and returns every complete record in it. A record
+     *        cut off by the end of the buffer is returned by the next call; at the end of the file,
+     *        trailing bytes form a last record (a final line without a newline).
+     * @param records Filled with the records; their pointers stay valid until the next call.
+     * @return False once the file is exhausted.
+     */
+    bool nextBatch(vector<Record>& records) {
+        records.clear();
+        while (records.empty()) {
+            if (begin > 0 || end < buffer.size()) {
+                refill();
+            } else {
+                buffer.resize(buffer.size() * 2);  // A single record fills the whole buffer
+                refill();
+            }
+            size_t position = begin;
+            while (true) {
+                while (position < end && isBetweenRecords(buffer[position])) {
+                    ++position;
+                }
+                if (position == end) {
+                    break;
+                }
+                size_t last = recordEnd(position);
+                if (last == string::npos) {
+                    if (!atEnd) {
+                        break;
+                    }
+                    last = end;
+                }
+                records.push_back({buffer.data() + position, last - position, bufferOffset + position});
+                position = last;
+            }
+            begin = position;
+            if (atEnd && begin == end) {
+                return !records.empty();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns true for files read as JSON Lines (.jsonl or .ndjson, optionally gzip-compressed).
+     */
+    static bool isJsonLinesFile(const string& filePath) {
+        filesystem::path path(filePath);
+        if (path.extension() == ".gz") {
+            path = path.stem();
+        }
+        string extension = path.extension().string();
+        return extension == ".jsonl" || extension == ".ndjson";
+    }
+
+    /**
+     * @brief Returns the locator of the record at `offset` in a file.
+     */
+    static string makeLocator(const string& filePath, size_t offset) {
+        return filePath + "#" + to_string(offset);
+    }
+
+    /**
+     * @brief Splits a "file#offset" locator. A plain path (or an existing file whose name merely
+     *        ends in "#digits") names a whole file.
+     * @return True if the locator names a record, with its file and offset filled in.
+     */
+    static bool splitLocator(const string& locator, string& filePath, size_t& offset) {
+        size_t hash = locator.rfind('#');
+        if (hash == string::npos || hash + 1 == locator.size() ||
+            locator.find_first_not_of("0123456789", hash + 1) != string::npos || filesystem::exists(locator)) {
+            return false;
+        }
+        filePath = locator.substr(0, hash);
+        offset = stoull(locator.substr(hash + 1));
+        return true;
+    }
+
+    /**
+     * @brief Reads the JSON text of a document, given its file path or record locator.
+     * @param locator A file path, or a "file#offset" locator from makeLocator.
+     * @param content Filled with the document's JSON text.
+     * @return False if the file cannot be opened or holds no record at the offset.
+     */
+    static bool readDocument(const string& locator, string& content) {
+        string filePath;
+        size_t offset = 0;
+        if (!splitLocator(locator, filePath, offset)) {
+            if (GzipFile::isGzipFile(locator)) {
+                return GzipFile::readAll(locator, content);
+            }
+            ifstream input(locator, ios::binary);
+            if (!input.is_open()) {
+                return false;
+            }
+            content.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+            return true;
+        }
+        // Articles are a few KiB, so a small buffer usually holds the whole record. In a gzip file the
+        // record is reached by inflating from the nearest seek point, or from the start without one.
+        JsonRecordReader reader(filePath, isJsonLinesFile(filePath), 64 << 10, offset);
+        vector<Record> records;
+        if (!reader.isOpen() || !reader.nextBatch(records) || records.front().offset != offset) {
+            return false;
+        }
+        content.assign(records.front().data, records.front().length);
+        return true;
+    }
+};
+
+#endif  // JSON_RECORD_READER_H
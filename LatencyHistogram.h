@@ -0,0 +1,137 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class LatencyHistogram
+ * @brief A fixed-precision latency histogram in the style of HdrHistogram. Values below
+ * 2^SUB_BUCKET_BITS nanoseconds get exact buckets; above that every power-of-two range is
+ * split into 2^(SUB_BUCKET_BITS - 1) equal buckets, so any recorded value is reported
+ * within about 1.6% while the whole 64-bit range fits in a few thousand counters.
+ * Histograms recorded on separate threads are combined with merge().
+ */
+class LatencyHistogram {
+   private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    static const uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+
+    vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t minValue = UINT64_MAX;
+    uint64_t maxValue = 0;
+    double sum = 0;
+
+    /**
+     * @brief Returns the number of bits a value needs to be shifted to fit in a sub-bucket.
+     */
+    static int shiftFor(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return 0;
+        }
+        int magnitude = 63 - __builtin_clzll(value);
+        return magnitude - SUB_BUCKET_BITS + 1;
+    }
+
+    /**
+     * @brief Maps a value to its bucket index.
+     */
+    static size_t bucketFor(uint64_t value) {
+        int shift = shiftFor(value);
+        return shift == 0 ? value : shift * HALF_SUB_BUCKETS + (value >> shift);
+    }
+
+    /**
+     * @brief Returns the largest value that maps to a bucket.
+     */
+    static uint64_t highestValueIn(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        int shift = static_cast<int>(bucket / HALF_SUB_BUCKETS) - 1;
+        uint64_t lowest = (bucket - shift * HALF_SUB_BUCKETS) << shift;
+        return lowest + (1ULL << shift) - 1;
+    }
+
+   public:
+    LatencyHistogram() : counts((64 - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS, 0) {}
+
+    /**
+     * @brief Records one latency.
+     * @param nanoseconds The measured latency in nanoseconds.
+     */
+    void record(uint64_t nanoseconds) {
+        ++counts[bucketFor(nanoseconds)];
+        ++total;
+        sum += nanoseconds;
+        minValue = nanoseconds < minValue ? nanoseconds : minValue;
+        maxValue = nanoseconds > maxValue ? nanoseconds : maxValue;
+    }
+
+    /**
+     * @brief Adds every value recorded in another histogram.
+     */
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        minValue = other.minValue < minValue ? other.minValue : minValue;
+        maxValue = other.maxValue > maxValue ? other.maxValue : maxValue;
+    }
+
+    /**
+     * @brief Returns the value at a percentile, e.g. 99.9, to within the histogram's precision.
+     */
+    uint64_t percentile(double percent) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        rank = rank == 0 ? 1 : rank > total ? total : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t value = highestValueIn(i);
+                return value < maxValue ? value : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    /**
+     * @brief Returns the number of recorded values.
+     */
+    uint64_t getCount() const {
+        return total;
+    }
+
+    /**
+     * @brief Returns the mean of the recorded values, or 0 if there are none.
+     */
+    double getMean() const {
+        return total == 0 ? 0 : sum / total;
+    }
+
+    /**
+     * @brief Returns the smallest recorded value, or 0 if there are none.
+     */
+    uint64_t getMin() const {
+        return total == 0 ? 0 : minValue;
+    }
+
+    /**
+     * @brief Returns the largest recorded value.
+     */
+    uint64_t getMax() const {
+        return maxValue;
+    }
+};
+
+#endif  // LATENCY_HISTOGRAM_H
@@ -0,0 +1,58 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * @class MemoryAccounting
+ * @brief Estimates of the heap bytes held by the index containers; ProcessMemory measures
+ * the process's resident set size to compare them with. The estimates model a 64-bit glibc heap and the libstdc++ node
+ * layouts: every allocation carries an 8-byte header and is rounded up to 16 bytes,
+ * and strings short enough for the small-string buffer allocate nothing.
+ */
+class MemoryAccounting {
+   public:
+    // Bytes of the red-black tree links in every std::map node (color and three pointers)
+    static const size_t MAP_NODE_LINKS = 32;
+
+    /**
+     * @brief Returns the bytes the allocator really uses for a request of `requested` bytes.
+     */
+    static size_t allocationBytes(size_t requested) {
+        size_t chunk = (requested + 8 + 15) / 16 * 16;
+        return chunk < 32 ? 32 : chunk;
+    }
+
+    /**
+     * @brief Returns the heap bytes owned by a string, which is 0 for short strings stored inline.
+     */
+    static size_t stringHeapBytes(const string& text) {
+        const char* data = text.data();
+        bool isInline = data >= reinterpret_cast<const char*>(&text) && data < reinterpret_cast<const char*>(&text + 1);
+        return isInline ? 0 : allocationBytes(text.capacity() + 1);
+    }
+
+    /**
+     * @brief Returns the bytes of one std::map node holding a `Value` (excluding what the value owns).
+     */
+    template <typename Value>
+    static size_t mapNodeBytes() {
+        return allocationBytes(MAP_NODE_LINKS + sizeof(Value));
+    }
+
+    /**
+     * @brief Returns the bytes of an unordered_map's nodes and bucket array (excluding what the entries own).
+     */
+    template <typename Key, typename Value>
+    static size_t unorderedMapBytes(const unordered_map<Key, Value>& table) {
+        // Each node holds a next pointer, the entry and a cached hash code
+        size_t node = allocationBytes(sizeof(void*) + sizeof(pair<const Key, Value>) + sizeof(size_t));
+        return table.size() * node + allocationBytes(table.bucket_count() * sizeof(void*));
+    }
+};
+
+#endif  // MEMORY_ACCOUNTING_H
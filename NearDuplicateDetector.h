@@ -0,0 +1,148 @@
+#ifndef NEAR_DUPLICATE_DETECTOR_H
+#define NEAR_DUPLICATE_DETECTOR_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class NearDuplicateDetector
+ * @brief Detects near-duplicate documents with MinHash signatures over word shingles.
+ * Signatures are split into bands for locality-sensitive hashing, so each new document
+ * is only compared against earlier documents that share at least one band.
+ */
+class NearDuplicateDetector {
+   private:
+    static const size_t NUM_HASHES = 64;      // MinHash signature length
+    static const size_t ROWS_PER_BAND = 4;    // Signature rows hashed together into one LSH band
+    static const size_t SHINGLE_SIZE = 3;     // Consecutive words per shingle
+
+    typedef array<uint64_t, NUM_HASHES> Signature;
+
+    // Estimated Jaccard similarity at or above which two documents are near duplicates
+    double threshold;
+
+    // Signatures of the documents kept so far, and the band buckets that index them
+    vector<Signature> signatures;
+    unordered_map<uint64_t, vector<size_t>> bandBuckets;
+
+    /**
+     * @brief Mixes a 64-bit value (splitmix64 finalizer), used to derive independent hash functions.
+     */
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * @brief Builds the MinHash signature of a token sequence.
+     */
+    static Signature computeSignature(const vector<string>& tokens) {
+        Signature signature;
+        signature.fill(UINT64_MAX);
+
+        vector<uint64_t> wordHashes;
+        wordHashes.reserve(tokens.size());
+        for (const auto& token : tokens) {
+            wordHashes.push_back(hashString(token));
+        }
+
+        for (size_t i = 0; i + SHINGLE_SIZE <= wordHashes.size(); ++i) {
+            uint64_t shingle = 0;
+            for (size_t j = 0; j < SHINGLE_SIZE; ++j) {
+                shingle = mix(shingle ^ wordHashes[i + j]);
+            }
+            for (size_t h = 0; h < NUM_HASHES; ++h) {
+                uint64_t value = mix(shingle ^ (h * 0x632be59bd9b4e019ULL));
+                if (value < signature[h]) {
+                    signature[h] = value;
+                }
+            }
+        }
+        return signature;
+    }
+
+    /**
+     * @brief Estimates the Jaccard similarity of two documents from their signatures.
+     */
+    static double similarity(const Signature& a, const Signature& b) {
+        size_t equal = 0;
+        for (size_t h = 0; h < NUM_HASHES; ++h) {
+            equal += a[h] == b[h];
+        }
+        return static_cast<double>(equal) / NUM_HASHES;
+    }
+
+   public:
+    /**
+     * @brief Hashes a string with 64-bit FNV-1a.
+     */
+    static uint64_t hashString(const string& text) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char ch : text) {
+            hash = (hash ^ ch) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Constructs a detector.
+     * @param similarityThreshold Estimated Jaccard similarity at which documents count as near duplicates.
+     */
+    explicit NearDuplicateDetector(double similarityThreshold = 0.8) : threshold(similarityThreshold) {}
+
+    /**
+     * @brief Checks a document against every document kept so far and keeps it if it is new.
+     *        The first document of a group of near duplicates stays as its representative.
+     * @param tokens The analyzed tokens of the document.
+     * @return True if the document is a near duplicate of a kept document.
+     */
+    bool isNearDuplicate(const vector<string>& tokens) {
+        if (tokens.size() < SHINGLE_SIZE) {
+            return false; // Too short to compare reliably
+        }
+
+        Signature signature = computeSignature(tokens);
+        vector<uint64_t> bandKeys;
+        for (size_t band = 0; band < NUM_HASHES / ROWS_PER_BAND; ++band) {
+            uint64_t key = mix(band);
+            for (size_t row = 0; row < ROWS_PER_BAND; ++row) {
+                key = mix(key ^ signature[band * ROWS_PER_BAND + row]);
+            }
+            bandKeys.push_back(key);
+
+            auto bucket = bandBuckets.find(key);
+            if (bucket == bandBuckets.end()) {
+                continue;
+            }
+            for (size_t candidate : bucket->second) {
+                if (similarity(signature, signatures[candidate]) >= threshold) {
+                    return true;
+                }
+            }
+        }
+
+        size_t index = signatures.size();
+        signatures.push_back(signature);
+        for (uint64_t key : bandKeys) {
+            bandBuckets[key].push_back(index);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Forgets every kept document.
+     */
+    void makeEmpty() {
+        signatures.clear();
+        bandBuckets.clear();
+    }
+};
+
+#endif  // NEAR_DUPLICATE_DETECTOR_H
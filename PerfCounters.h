@@ -0,0 +1,172 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * @class PerfCounters
+ * @brief Hardware performance counters of the calling thread (cycles, instructions, cache
+ * misses, branch misses) read through Linux perf_event_open. Each event is opened on its
+ * own, so a machine or container that lacks some of them still reports the rest; when none
+ * can be opened (other platforms, perf_event_paranoid, virtual machines) isAvailable() is
+ * false and every reading is empty, so callers only need to skip printing.
+ */
+class PerfCounters {
+   public:
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, EVENT_COUNT };
+
+    /**
+     * @struct Counts
+     * @brief One reading of every event; events that could not be opened stay unavailable.
+     */
+    struct Counts {
+        double values[EVENT_COUNT] = {};
+        bool available[EVENT_COUNT] = {};
+
+        /**
+         * @brief Adds the difference between two readings of the same counters.
+         */
+        void addDelta(const Counts& start, const Counts& end) {
+            for (int event = 0; event < EVENT_COUNT; ++event) {
+                available[event] = start.available[event] && end.available[event];
+                values[event] += available[event] ? end.values[event] - start.values[event] : 0;
+            }
+        }
+
+        /**
+         * @brief Adds another accumulated total.
+         */
+        void add(const Counts& other) {
+            for (int event = 0; event < EVENT_COUNT; ++event) {
+                available[event] = available[event] || other.available[event];
+                values[event] += other.values[event];
+            }
+        }
+
+        /**
+         * @brief Returns true if at least one event was measured.
+         */
+        bool any() const {
+            for (bool measured : available) {
+                if (measured) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Returns instructions per cycle, or 0 if either was not measured.
+         */
+        double instructionsPerCycle() const {
+            bool measured = available[CYCLES] && available[INSTRUCTIONS] && values[CYCLES] > 0;
+            return measured ? values[INSTRUCTIONS] / values[CYCLES] : 0;
+        }
+    };
+
+   private:
+    int fds[EVENT_COUNT];
+    string unavailableReason;
+
+   public:
+    /**
+     * @brief Returns the short name of an event, as used in reports.
+     */
+    static const char* eventName(Event event) {
+        static const char* const names[EVENT_COUNT] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+        return names[event];
+    }
+
+    /**
+     * @brief Opens and starts the counters for the calling thread (user space only).
+     */
+    PerfCounters() {
+        for (int& fd : fds) {
+            fd = -1;
+        }
+#ifdef __linux__
+        static const uint64_t configs[EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[event];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[event] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds[event] < 0 && unavailableReason.empty()) {
+                unavailableReason = string("perf_event_open: ") + strerror(errno);
+            }
+        }
+#else
+        unavailableReason = "hardware counters are only supported on Linux";
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Returns true if at least one event could be opened.
+     */
+    bool isAvailable() const {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Returns why the first unavailable event could not be opened, or "" if all opened.
+     */
+    const string& getUnavailableReason() const {
+        return unavailableReason;
+    }
+
+    /**
+     * @brief Reads every open counter, scaled up when the kernel had to multiplex it.
+     */
+    Counts read() const {
+        Counts counts;
+#ifdef __linux__
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            uint64_t data[3];  // value, time enabled, time running
+            if (fds[event] < 0 || ::read(fds[event], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+                continue;
+            }
+            counts.values[event] = data[2] > 0 ? static_cast<double>(data[0]) * data[1] / data[2] : 0;
+            counts.available[event] = true;
+        }
+#endif
+        return counts;
+    }
+};
+
+#endif  // PERF_COUNTERS_H
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "AvlTree.h"
+#include "DocumentParser.h"
+#include "DocumentTable.h"
+#include "LatencyHistogram.h"
+#include "QueryProcessor.h"
+#include "rapidjson/document.h"      // For reading the baseline and benchmark results
+#include "rapidjson/prettywriter.h"  // For writing the baseline
+#include "rapidjson/stringbuffer.h"
+
+using namespace std;
+using namespace rapidjson;
+
+// Allowed slowdown when neither the baseline nor the command line sets one
+static const double DEFAULT_TOLERANCE = 0.3;
+
+/**
+ * @struct Metric
+ * @brief One measured number and which direction of change is a regression.
+ */
+struct Metric {
+    string name;
+    double value;
+    bool higherIsBetter;
+};
+
+/**
+ * @struct Baseline
+ * @brief Stored reference values, with a default tolerance and optional per-metric ones.
+ */
+struct Baseline {
+    double tolerance = DEFAULT_TOLERANCE;
+    map<string, double> values;
+    map<string, double> tolerances;
+};
+
+/**
+ * @brief Indexes the corpus with a fresh parser and returns the documents indexed per second.
+ * @param saveDirectory If not empty, where to save the index for the load and query measurements.
+ */
+static double measureIndexing(const string& corpus, const string& saveDirectory) {
+    AvlTree<string> PersonTree;
+    AvlTree<string> OrganizationTree;
+    AvlTree<string> WordsTree;
+    DocumentTable Documents;
+    DocumentParser parser(PersonTree, OrganizationTree, WordsTree, Documents);
+
+    auto start = chrono::steady_clock::now();
+    for (const auto& entry : filesystem::recursive_directory_iterator(corpus)) {
+        if (entry.is_regular_file()) {
+            parser.runDocument(entry.path().string());
+        }
+    }
+    parser.finishIndexing();
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+
+    if (!saveDirectory.empty()) {
+        filesystem::create_directories(saveDirectory);
+        parser.toFile(saveDirectory + "/personTree.txt", saveDirectory + "/organizationTree.txt",
+                      saveDirectory + "/wordsTree.txt", saveDirectory + "/documentTable.txt");
+    }
+    return parser.getFilesIndexed() / seconds.count();
+}
+
+/**
+ * @brief Reads a saved index into the given structures and returns the seconds it took.
+ */
+static double loadIndex(QueryProcessor& processor, const string& directory) {
+    auto start = chrono::steady_clock::now();
+    processor.getTreesfromFile(directory + "/personTree.txt", directory + "/organizationTree.txt",
+                               directory + "/wordsTree.txt", directory + "/documentTable.txt");
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Adds the median ns/op of every benchmark in a supersearch_bench JSON report as `bench.<name>`.
+ * @return False if the report cannot be read.
+ */
+static bool readBenchmarks(const string& filePath, vector<Metric>& metrics) {
+    ifstream input(filePath);
+    if (!input) {
+        return false;
+    }
+    stringstream content;
+    content << input.rdbuf();
+    Document report;
+    report.Parse(content.str().c_str());
+    if (report.HasParseError() || !report.HasMember("benchmarks") || !report["benchmarks"].IsArray()) {
+        return false;
+    }
+    for (const auto& benchmark : report["benchmarks"].GetArray()) {
+        if (benchmark.HasMember("name") && benchmark.HasMember("median_ns_per_op")) {
+            metrics.push_back({string("bench.") + benchmark["name"].GetString(),
+                               benchmark["median_ns_per_op"].GetDouble(), false});
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a baseline file.
+ * @return False if the file does not exist or cannot be parsed.
+ */
+static bool readBaseline(const string& filePath, Baseline& baseline) {
+    ifstream input(filePath);
+    if (!input) {
+        return false;
+    }
+    stringstream content;
+    content << input.rdbuf();
+    Document document;
+    document.Parse(content.str().c_str());
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember("metrics") ||
+        !document["metrics"].IsObject()) {
+        return false;
+    }
+    if (document.HasMember("tolerance") && document["tolerance"].IsNumber()) {
+        baseline.tolerance = document["tolerance"].GetDouble();
+    }
+    for (const auto& metric : document["metrics"].GetObject()) {
+        const auto& entry = metric.value;
+        if (entry.HasMember("value") && entry["value"].IsNumber()) {
+            baseline.values[metric.name.GetString()] = entry["value"].GetDouble();
+        }
+        if (entry.HasMember("tolerance") && entry["tolerance"].IsNumber()) {
+            baseline.tolerances[metric.name.GetString()] = entry["tolerance"].GetDouble();
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the measured metrics as the new baseline, keeping the existing tolerances.
+ */
+static bool writeBaseline(const string& filePath, const Baseline& previous, const vector<Metric>& metrics) {
+    StringBuffer buffer;
+    PrettyWriter<StringBuffer> writer(buffer);
+    writer.SetIndent(' ', 2);
+    writer.StartObject();
+    writer.Key("tolerance");
+    writer.Double(previous.tolerance);
+    writer.Key("metrics");
+    writer.StartObject();
+    for (const auto& metric : metrics) {
+        writer.Key(metric.name.c_str());
+        writer.StartObject();
+        writer.Key("value");
+        writer.Double(metric.value);
+        writer.Key("higher_is_better");
+        writer.Bool(metric.higherIsBetter);
+        auto tolerance = previous.tolerances.find(metric.name);
+        if (tolerance != previous.tolerances.end()) {
+            writer.Key("tolerance");
+            writer.Double(tolerance->second);
+        }
+        writer.EndObject();
+    }
+    writer.EndObject();
+    writer.EndObject();
+
+    ofstream output(filePath);
+    if (!output) {
+        return false;
+    }
+    output << buffer.GetString() << "\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        cerr << "Usage:\n"
+             << argv[0] << " <corpus-directory> <query-log> <baseline-file> [--bench=<bench-json>] [--rounds=<n>]\n"
+             << "      [--query-passes=<n>] [--tolerance=<fraction>] [--work=<directory>] [--update]\n";
+        return 2;
+    }
+
+    string corpus = argv[1];
+    string logFile = argv[2];
+    string baselineFile = argv[3];
+    string benchFile;
+    string workDirectory = "perf_work";
+    int rounds = 3;
+    int queryPasses = 20;
+    double toleranceOverride = -1;
+    bool update = false;
+    for (int i = 4; i < argc; ++i) {
+        string option = argv[i];
+        string value = option.substr(option.find('=') + 1);
+        if (option.rfind("--bench=", 0) == 0) {
+            benchFile = value;
+        } else if (option.rfind("--rounds=", 0) == 0) {
+            rounds = max(1, stoi(value));
+        } else if (option.rfind("--query-passes=", 0) == 0) {
+            queryPasses = max(1, stoi(value));
+        } else if (option.rfind("--tolerance=", 0) == 0) {
+            toleranceOverride = stod(value);
+        } else if (option.rfind("--work=", 0) == 0) {
+            workDirectory = value;
+        } else if (option == "--update") {
+            update = true;
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 2;
+        }
+    }
+
+    vector<string> queries;
+    ifstream log(logFile);
+    for (string line; getline(log, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            queries.push_back(line);
+        }
+    }
+    if (queries.empty()) {
+        cerr << "No queries in " << logFile << endl;
+        return 2;
+    }
+    DocumentParser::loadStopWords("stopWords.txt");
+
+    // Each measurement keeps the best of several rounds, which is the least noisy estimate of what the code can do
+    string indexDirectory = workDirectory + "/index";
+    double docsPerSecond = 0;
+    for (int round = 0; round < rounds; ++round) {
+        docsPerSecond = max(docsPerSecond, measureIndexing(corpus, round == 0 ? indexDirectory : ""));
+    }
+
+    double loadSeconds = 0;
+    for (int round = 0; round < rounds; ++round) {
+        AvlTree<string> PersonTree;
+        AvlTree<string> OrganizationTree;
+        AvlTree<string> WordsTree;
+        DocumentTable Documents;
+        QueryProcessor processor(PersonTree, OrganizationTree, WordsTree, Documents);
+        double seconds = loadIndex(processor, indexDirectory);
+        loadSeconds = round == 0 ? seconds : min(loadSeconds, seconds);
+    }
+
+    AvlTree<string> PersonTree;
+    AvlTree<string> OrganizationTree;
+    AvlTree<string> WordsTree;
+    DocumentTable Documents;
+    QueryProcessor processor(PersonTree, OrganizationTree, WordsTree, Documents);
+    loadIndex(processor, indexDirectory);
+    for (const auto& query : queries) {
+        processor.evaluateQuery(query, 15);  // Warmup
+    }
+    double queryP99 = 0;
+    for (int round = 0; round < rounds; ++round) {
+        LatencyHistogram latencies;
+        for (int pass = 0; pass < queryPasses; ++pass) {
+            for (const auto& query : queries) {
+                auto start = chrono::steady_clock::now();
+                processor.evaluateQuery(query, 15);
+                latencies.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            }
+        }
+        double p99 = latencies.percentile(99) / 1000.0;
+        queryP99 = round == 0 ? p99 : min(queryP99, p99);
+    }
+
+    vector<Metric> metrics = {{"indexing_docs_per_sec", docsPerSecond, true},
+                              {"load_seconds", loadSeconds, false},
+                              {"query_p99_us", queryP99, false}};
+    if (!benchFile.empty() && !readBenchmarks(benchFile, metrics)) {
+        cerr << "Error: Unable to read benchmark results from " << benchFile << endl;
+        return 2;
+    }
+
+    Baseline baseline;
+    bool hasBaseline = readBaseline(baselineFile, baseline);
+    if (toleranceOverride >= 0) {
+        baseline.tolerance = toleranceOverride;
+        baseline.tolerances.clear();
+    }
+    if (update || !hasBaseline) {
+        if (!writeBaseline(baselineFile, baseline, metrics)) {
+            cerr << "Error: Unable to open file " << baselineFile << " for writing." << endl;
+            return 2;
+        }
+        cout << (hasBaseline ? "Updated" : "No baseline found; recorded") << " baseline " << baselineFile << "\n";
+    }
+
+    // A change counts as a slowdown in whichever direction is worse for the metric
+    int regressions = 0;
+    cout << left << setw(32) << "metric" << right << setw(14) << "baseline" << setw(14) << "current" << setw(10)
+         << "change" << setw(11) << "tolerance" << "  status\n";
+    for (const auto& metric : metrics) {
+        cout << left << setw(32) << metric.name << right << fixed << setprecision(2);
+        auto reference = baseline.values.find(metric.name);
+        if (reference == baseline.values.end() || reference->second <= 0) {
+            cout << setw(14) << "-" << setw(14) << metric.value << setw(10) << "-" << setw(11) << "-" << "  new\n";
+            continue;
+        }
+        double change = (metric.value - reference->second) / reference->second;
+        double slowdown = metric.higherIsBetter ? -change : change;
+        double tolerance =
+            baseline.tolerances.count(metric.name) ? baseline.tolerances[metric.name] : baseline.tolerance;
+        string status = slowdown > tolerance ? "REGRESSED" : slowdown < -tolerance ? "improved" : "ok";
+        regressions += slowdown > tolerance;
+        cout << setw(14) << reference->second << setw(14) << metric.value << setprecision(1) << setw(9)
+             << showpos << change * 100 << noshowpos << "%" << setw(10) << tolerance * 100 << "%"
+             << "  " << status << "\n";
+    }
+    cout.unsetf(ios::floatfield);
+
+    if (regressions > 0 && !update) {
+        cout << regressions << " metric(s) slowed down beyond tolerance.\n";
+        return 1;
+    }
+    cout << "No significant slowdowns.\n";
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * @class ProcessMemory
+ * @brief Measured memory of the running process, to compare with the estimates of
+ * MemoryAccounting. Kept apart from the index headers so that they need no system headers.
+ * Reports 0 where the measurement is unavailable.
+ */
+class ProcessMemory {
+   public:
+    /**
+     * @brief Returns the peak resident set size of the process in bytes, or 0 if unavailable.
+     */
+    static size_t peakResidentBytes() {
+#ifdef __linux__
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Linux reports kilobytes
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief Returns the current resident set size of the process in bytes, or 0 if unavailable.
+     */
+    static size_t currentResidentBytes() {
+#ifdef __linux__
+        ifstream statm("/proc/self/statm");
+        size_t pages = 0, resident = 0;
+        if (!(statm >> pages >> resident)) {
+            return 0;
+        }
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+        return 0;
+#endif
+    }
+};
+
+#endif  // PROCESS_MEMORY_H
@@ -0,0 +1,228 @@
+#ifndef QUERY_EXPLAIN_H
+#define QUERY_EXPLAIN_H
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "JsonEscape.h"
+
+using namespace std;
+
+/**
+ * @class QueryExplain
+ * @brief Records how QueryProcessor evaluated one query: how each term was analyzed, the order
+ * its posting lists were fetched in and how long that took, the result size after every
+ * intersection and exclusion, and the time spent ranking and printing. It is printed as a
+ * tree or written as JSON. The processor only reads the clock while an explain is attached.
+ */
+class QueryExplain {
+   public:
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * @struct Term
+     * @brief One query token and what analysis made of it.
+     */
+    struct Term {
+        string text;      // The token as typed
+        string field;     // "WORD", "PERSON" or "ORG"; empty if the token was dropped or is a filter
+        string analyzed;  // The key looked up in the field's tree
+        bool excluded;
+        string note;      // Why the token was dropped, or the kind of filter it is
+    };
+
+    /**
+     * @struct Step
+     * @brief One evaluation step: fetching a posting list, or combining it into the result.
+     */
+    struct Step {
+        string scope;       // The time partition evaluated, empty for the shared trees
+        string operation;   // fetch, exclude-fetch, start, date-filter, intersect, exclude or stop
+        string field;
+        string key;
+        int documentFrequency;  // Dictionary document frequency (fetches only, -1 otherwise)
+        size_t size;        // Postings fetched, or documents in the result after the step
+        double seconds;
+    };
+
+   private:
+    string query;
+    string path;
+    vector<Term> terms;
+    vector<Step> steps;
+    string scope;
+    bool championsTried = false;
+    bool championsAnswered = false;
+    double championSeconds = 0;
+    double evaluationSeconds = 0;
+    size_t candidates = 0;
+    size_t ranked = 0;
+    double rankingSeconds = 0;
+    size_t outputDocuments = 0;
+    double outputSeconds = 0;
+
+    static double milliseconds(double seconds) {
+        return seconds * 1000;
+    }
+
+   public:
+    /**
+     * @brief Returns the seconds elapsed since `start`.
+     */
+    static double secondsSince(Clock::time_point start) {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    /**
+     * @brief Starts explaining a new query, discarding the previous one.
+     * @param search The query string.
+     * @param evaluationPath How the query is evaluated, e.g. "ranked" or "count".
+     */
+    void reset(const string& search, const string& evaluationPath) {
+        *this = QueryExplain();
+        query = search;
+        path = evaluationPath;
+    }
+
+    /**
+     * @brief Returns true once the query's tokens have been recorded; a query parsed again records nothing new.
+     */
+    bool hasTerms() const {
+        return !terms.empty();
+    }
+
+    void addTerm(const string& text, const string& field, const string& analyzed, bool excluded,
+                 const string& note = "") {
+        terms.push_back({text, field, analyzed, excluded, note});
+    }
+
+    /**
+     * @brief Names the partition the following steps evaluate (empty for the shared trees).
+     */
+    void setScope(const string& partition) {
+        scope = partition;
+    }
+
+    void addStep(const string& operation, const string& field, const string& key, int documentFrequency, size_t size,
+                 double seconds) {
+        steps.push_back({scope, operation, field, key, documentFrequency, size, seconds});
+    }
+
+    void setChampions(bool answered, double seconds) {
+        championsTried = true;
+        championsAnswered = answered;
+        championSeconds += seconds;
+    }
+
+    void setEvaluationSeconds(double seconds) {
+        evaluationSeconds = seconds;
+    }
+
+    void setCandidates(size_t count) {
+        candidates = count;
+    }
+
+    /**
+     * @brief Adds ranking time; later pages are ranked on demand, so this accumulates.
+     */
+    void addRanking(size_t rankedCount, double seconds) {
+        ranked = rankedCount;
+        rankingSeconds += seconds;
+    }
+
+    void addOutput(size_t documents, double seconds) {
+        outputDocuments += documents;
+        outputSeconds += seconds;
+    }
+
+    const vector<Term>& getTerms() const {
+        return terms;
+    }
+
+    const vector<Step>& getSteps() const {
+        return steps;
+    }
+
+    /**
+     * @brief Prints the explanation as an indented tree, with times in milliseconds.
+     */
+    void printTree(ostream& out) const {
+        out << fixed << setprecision(3);
+        out << "query \"" << query << "\" (" << path << ") evaluated in " << milliseconds(evaluationSeconds)
+            << " ms\n";
+        out << "+- terms\n";
+        for (const auto& term : terms) {
+            out << "|  +- \"" << term.text << "\" ";
+            if (term.field.empty()) {
+                out << term.note << "\n";
+            } else {
+                out << (term.excluded ? "excludes " : "") << term.field << ":" << term.analyzed << "\n";
+            }
+        }
+        if (championsTried) {
+            out << "+- champions: " << (championsAnswered ? "answered the page" : "could not guarantee the page")
+                << " in " << milliseconds(championSeconds) << " ms\n";
+        }
+        out << "+- evaluation (rarest list first)\n";
+        for (const auto& step : steps) {
+            out << "|  +- " << (step.scope.empty() ? "" : "[" + step.scope + "] ") << step.operation;
+            if (!step.key.empty()) {
+                out << " " << step.field << ":" << step.key;
+            }
+            if (step.documentFrequency >= 0) {
+                out << " (df " << step.documentFrequency << "): " << step.size << " postings";
+            } else {
+                out << ": " << step.size << " documents";
+            }
+            out << ", " << milliseconds(step.seconds) << " ms\n";
+        }
+        out << "+- ranking: " << candidates << " candidates, " << ranked << " ranked, "
+            << milliseconds(rankingSeconds) << " ms\n";
+        out << "+- output: " << outputDocuments << " documents, " << milliseconds(outputSeconds) << " ms\n";
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+    }
+
+    /**
+     * @brief Writes the explanation as JSON, with times in milliseconds.
+     */
+    void writeJson(ostream& out) const {
+        out << "{\n  \"query\": \"" << JsonEscape::escape(query) << "\",\n  \"path\": \"" << path
+            << "\",\n  \"evaluation_ms\": " << milliseconds(evaluationSeconds) << ",\n  \"terms\": [";
+        for (size_t i = 0; i < terms.size(); ++i) {
+            const Term& term = terms[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"text\": \"" << JsonEscape::escape(term.text) << "\", \"field\": \""
+                << term.field << "\", \"analyzed\": \"" << JsonEscape::escape(term.analyzed)
+                << "\", \"excluded\": " << (term.excluded ? "true" : "false") << ", \"note\": \"" << term.note
+                << "\"}";
+        }
+        out << "\n  ],\n  \"champions\": ";
+        if (championsTried) {
+            out << "{\"answered\": " << (championsAnswered ? "true" : "false")
+                << ", \"ms\": " << milliseconds(championSeconds) << "}";
+        } else {
+            out << "null";
+        }
+        out << ",\n  \"steps\": [";
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const Step& step = steps[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"scope\": \"" << step.scope << "\", \"operation\": \""
+                << step.operation << "\", \"field\": \"" << step.field << "\", \"key\": \"" << JsonEscape::escape(step.key)
+                << "\", ";
+            if (step.documentFrequency >= 0) {
+                out << "\"df\": " << step.documentFrequency << ", \"postings\": " << step.size;
+            } else {
+                out << "\"documents\": " << step.size;
+            }
+            out << ", \"ms\": " << milliseconds(step.seconds) << "}";
+        }
+        out << "\n  ],\n  \"ranking\": {\"candidates\": " << candidates << ", \"ranked\": " << ranked
+            << ", \"ms\": " << milliseconds(rankingSeconds) << "},\n  \"output\": {\"documents\": "
+            << outputDocuments << ", \"ms\": " << milliseconds(outputSeconds) << "}\n}\n";
+    }
+};
+
+#endif  // QUERY_EXPLAIN_H
@@ -2,10 +2,17 @@
 #define QUERY_PROCESSOR_H
 
 #include <cmath>
+#include <limits>
 #include <map>
 #include <vector>
+#include "AllocationTracker.h"
 #include "AvlTree.h"
 #include "DocumentParser.h"
+#include "ChampionLists.h"
+#include "DocumentTable.h"
+#include "QueryExplain.h"
+#include "TimePartitionedIndex.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -17,6 +24,30 @@ class QueryProcessor {
     AvlTree<string>& OrganizationTree;
     AvlTree<string>& WordsTree;
 
+    // Per-document columns used for filtering without opening documents
+    DocumentTable& Documents;
+
+    // Optional month partitions searched instead of the shared trees
+    TimePartitionedIndex* Partitions = nullptr;
+
+    // Newest-first mode: search partitions newest to oldest and stop after this many results
+    bool newestFirst = false;
+    size_t newestFirstLimit = 15;
+
+    // Publication-date filter from a "date:[from TO to]" or "recent:<days>" term, as a docID-ordered bitset
+    bool hasDateFilter = false;
+    vector<bool> dateFilter;
+    long long dateFrom = DocumentTable::NO_TIMESTAMP;   // Inclusive bounds used for partition pruning
+    long long dateTo = DocumentTable::NO_TIMESTAMP;
+
+    // A classified search term: the tree it targets ("ORG", "PERSON" or "WORD"), its key, and whether it is excluded
+    struct QueryTerm {
+        string field;
+        string key;
+        bool excluded;
+    };
+    vector<QueryTerm> queryTerms;
+
     // Stores maps of query results and exclusion maps
     vector<map<string, int>> vectorOfMaps;
     vector<map<string, int>> vectorOfBadMaps;
@@ -24,74 +55,636 @@ class QueryProcessor {
     // Vector to hold document-frequency pairs for ranking
     vector<pair<string, int>> documentFrequencyPairs;
 
+    // Matched documents as (document ID, frequency), in path order
+    vector<pair<int, int>> rankCandidates;
+
+    // A single term's postings in document ID order, ranked instead of rankCandidates when set
+    const vector<pair<int, int>>* rankedPostings = nullptr;
+    int maxCandidateFrequency = 0;
+
+    // Document table numbering the trees' ranked postings were built against
+    size_t rankedNumbering = 0;
+
+    // True while documentFrequencyPairs holds only the top of the ranked candidates
+    bool rankingPending = false;
+
+    // Optional champion lists used to answer short word queries without scanning whole posting lists
+    const ChampionLists* Champions = nullptr;
+
+    // The query whose page was answered from champion lists alone; full results are computed on demand
+    string championSearch;
+
     // Index to track pagination during document output
     size_t searchIndex = 0;
 
+    // Optional record of how the current query was evaluated; nullptr disables explaining
+    QueryExplain* Explain = nullptr;
+
+    // The terms behind vectorOfMaps and vectorOfBadMaps, kept only while explaining
+    vector<const QueryTerm*> explainedMaps;
+    vector<const QueryTerm*> explainedBadMaps;
+
+    // The matched documents being ranked
+    const vector<pair<int, int>>& candidates() const {
+        return rankedPostings != nullptr ? *rankedPostings : rankCandidates;
+    }
+
+    // Reads the clock only while explaining
+    QueryExplain::Clock::time_point explainStart() const {
+        return Explain != nullptr ? QueryExplain::Clock::now() : QueryExplain::Clock::time_point();
+    }
+
    public:
-    // Constructor initializes references to AVL trees
-    QueryProcessor(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& word)
-        : PersonTree(person), OrganizationTree(org), WordsTree(word) {}
+    // Weight of the static quality prior: score = frequency * (1 + STATIC_WEIGHT * staticScore)
+    static constexpr double STATIC_WEIGHT = 1.0;
+
+    // Constructor initializes references to AVL trees and the document table
+    QueryProcessor(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& word,
+                   DocumentTable& documents)
+        : PersonTree(person), OrganizationTree(org), WordsTree(word), Documents(documents) {}
+
+    // Searches the given month partitions instead of the shared trees (nullptr to disable).
+    // Call after loading the partitions: their documents get IDs here, not during queries.
+    void setPartitionedIndex(TimePartitionedIndex* partitions) {
+        Partitions = partitions;
+        if (Partitions != nullptr) {
+            for (auto* partition : Partitions->overlapping(DocumentTable::NO_TIMESTAMP, DocumentTable::NO_TIMESTAMP, false)) {
+                addMissingDocuments(partition->PersonTree);
+                addMissingDocuments(partition->OrganizationTree);
+                addMissingDocuments(partition->WordsTree);
+            }
+        }
+    }
+
+    // Enables newest-first ordering; partitioned searches stop once `limit` results are found
+    void setNewestFirst(bool enabled, size_t limit = 15) {
+        newestFirst = enabled;
+        newestFirstLimit = limit;
+    }
+
+    // Answers short word queries from these champion lists when they guarantee the top results (nullptr to disable)
+    void setChampionLists(const ChampionLists* champions) {
+        Champions = champions;
+    }
+
+    // Records how each following query is evaluated into `explain` (nullptr to disable)
+    void setExplain(QueryExplain* explain) {
+        Explain = explain;
+    }
 
     // Processes a search query and outputs the top results
     void runQueryProcessor(const string& search) {
-        // Clear previous data
-        documentFrequencyPairs.clear();
-        vectorOfMaps.clear();
-        vectorOfBadMaps;
-        searchIndex = 0;
+        evaluateQuery(search, 15);
+        outputDocuments(15); // Outputs the top 15 documents by default
+    }
+
+    // Evaluates a query and ranks its first `numDocuments` results without printing anything
+    void evaluateQuery(const string& search, size_t numDocuments) {
+        Trace::Span span("evaluateQuery", "query", &search);
+        AllocationTracker::Scope allocations(AllocationTracker::QUERY);
+        auto start = explainStart();
+        if (Explain != nullptr) {
+            Explain->reset(search, newestFirst ? "newest first" : Partitions != nullptr ? "partitioned" : "ranked");
+        }
+        clearQuery();
+
+        // Try the champion lists first; they only answer when the first page is guaranteed exact
+        auto championStart = explainStart();
+        bool answered = rankFromChampions(search, numDocuments);
+        if (Explain != nullptr && Champions != nullptr && Partitions == nullptr && !newestFirst) {
+            Explain->setChampions(answered, QueryExplain::secondsSince(championStart));
+        }
+        if (answered) {
+            if (Explain != nullptr) {
+                Explain->setCandidates(getRankedCount());
+                Explain->addRanking(getRankedCount(), 0);
+                Explain->setEvaluationSeconds(QueryExplain::secondsSince(start));
+            }
+            return;
+        }
+        clearQuery();
+
+        // A single-term query ranks straight from the term's postings in static-score order
+        auto rankingStart = explainStart();
+        if (useRankedPostings(search)) {
+            rankTopDocuments(numDocuments);
+            if (Explain != nullptr) {
+                Explain->setCandidates(candidates().size());
+                Explain->addRanking(getRankedCount(), QueryExplain::secondsSince(rankingStart));
+                Explain->setEvaluationSeconds(QueryExplain::secondsSince(start));
+            }
+            return;
+        }
+        clearQuery();
 
         // Process the query
         map<string, int> result = processQuery(search);
 
-        // Sort results by frequency and output top documents
-        sortDocumentsByFrequency(result);
-        outputDocuments(15); // Outputs the top 15 documents by default
+        // Sort results by frequency (or publication date in newest-first mode)
+        rankingStart = explainStart();
+        if (newestFirst) {
+            sortDocumentsByDate(result);
+        } else {
+            sortDocumentsByFrequency(result);
+        }
+        if (rankingPending) {
+            rankTopDocuments(numDocuments);
+        }
+        if (Explain != nullptr) {
+            Explain->setCandidates(candidates().size());
+            Explain->addRanking(getRankedCount(), QueryExplain::secondsSince(rankingStart));
+            Explain->setEvaluationSeconds(QueryExplain::secondsSince(start));
+        }
+    }
+
+    // Copies the trees' long posting lists in document ID order for ranked single-term queries.
+    // Call again after the document table is renumbered or the trees change.
+    void buildRankedPostings() {
+        Trace::Span span("buildRankedPostings", "query");
+        auto documentIDOf = [this](const string& name) { return Documents.getID(name); };
+        PersonTree.buildRankedPostings(documentIDOf);
+        OrganizationTree.buildRankedPostings(documentIDOf);
+        WordsTree.buildRankedPostings(documentIDOf);
+        rankedNumbering = Documents.getNumbering();
+    }
+
+    // Points the candidates at the ranked postings of a query's only term. Returns false (leaving the
+    // full evaluation to the caller) for anything else: several terms, exclusions, filters or partitions.
+    bool useRankedPostings(const string& search) {
+        if (Partitions != nullptr || newestFirst || Documents.getNumbering() != rankedNumbering ||
+            !Documents.isStaticOrdered()) {
+            return false;
+        }
+        parseQuery(search);
+        if (queryTerms.size() != 1 || queryTerms[0].excluded || hasDateFilter) {
+            return false;
+        }
+        const QueryTerm& term = queryTerms[0];
+        AvlTree<string>& tree = term.field == "ORG" ? OrganizationTree : term.field == "PERSON" ? PersonTree : WordsTree;
+        auto start = explainStart();
+        const vector<pair<int, int>>* postings = tree.getRankedPostings(term.key);
+        if (postings == nullptr) {
+            return false;
+        }
+        if (Explain != nullptr) {
+            Explain->addStep("ranked-postings", term.field, term.key, static_cast<int>(postings->size()),
+                             postings->size(), QueryExplain::secondsSince(start));
+        }
+        rankedPostings = postings;
+        maxCandidateFrequency = tree.getTermStats(term.key).maxTermFrequency;
+        rankingPending = true;
+        return true;
+    }
+
+    // Returns the number of results ranked so far
+    size_t getRankedCount() const {
+        return documentFrequencyPairs.size();
+    }
+
+    // Clears the state left by the previous query
+    void clearQuery() {
+        documentFrequencyPairs.clear();
+        rankCandidates.clear();
+        rankedPostings = nullptr;
+        rankingPending = false;
+        championSearch.clear();
+        vectorOfMaps.clear();
+        vectorOfBadMaps.clear();
+        explainedMaps.clear();
+        explainedBadMaps.clear();
+        queryTerms.clear();
+        hasDateFilter = false;
+        dateFilter.clear();
+        dateFrom = dateTo = DocumentTable::NO_TIMESTAMP;
+        searchIndex = 0;
     }
 
     // Processes a query string and returns the resulting map of document frequencies
     map<string, int> processQuery(string search) {
+        Trace::Span span("processQuery", "query", &search);
+        if (Partitions != nullptr) {
+            return processPartitions(search);
+        }
+
         SeperateString(search); // Tokenize and classify search terms
 
         if (vectorOfMaps.empty()) {
-            return {}; // Return an empty map if there are no valid query terms
+            // A date filter on its own matches every document in the range
+            return hasDateFilter ? documentsInDateRange() : map<string, int>();
         }
+        return combineMaps();
+    }
+
+    // Evaluates the query in every partition that overlaps the date filter and merges the results
+    map<string, int> processPartitions(const string& search) {
+        parseQuery(search);
 
-        // Start with the first map and find intersections with other maps
-        map<string, int> result = vectorOfMaps[0];
+        bool hasPositiveTerm = false;
+        for (const auto& term : queryTerms) {
+            hasPositiveTerm = hasPositiveTerm || !term.excluded;
+        }
+        if (!hasPositiveTerm) {
+            return hasDateFilter ? documentsInDateRange() : map<string, int>();
+        }
+
+        // Partitions hold disjoint documents, so merging their results is a plain union
+        map<string, int> result;
+        for (auto* partition : Partitions->overlapping(dateFrom, dateTo, newestFirst)) {
+            if (newestFirst && result.size() >= newestFirstLimit) {
+                break;
+            }
+            vectorOfMaps.clear();
+            vectorOfBadMaps.clear();
+            explainedMaps.clear();
+            explainedBadMaps.clear();
+            if (Explain != nullptr) {
+                Explain->setScope(partition->key);
+            }
+            fetchTermMaps(partition->PersonTree, partition->OrganizationTree, partition->WordsTree);
+            map<string, int> partitionResult = combineMaps();
+            result.insert(partitionResult.begin(), partitionResult.end());
+        }
+        if (Explain != nullptr) {
+            Explain->setScope("");
+        }
+        return result;
+    }
+
+    // Intersects the fetched term maps (restricted to the date range) and removes excluded documents
+    map<string, int> combineMaps() {
+        if (vectorOfMaps.empty()) {
+            return {};
+        }
+
+        // Records a step named after the term behind the i-th map, when explaining
+        auto explainStep = [this](const string& operation, const vector<const QueryTerm*>& terms, size_t i,
+                                  size_t size, QueryExplain::Clock::time_point start) {
+            if (Explain != nullptr) {
+                const QueryTerm* term = i < terms.size() ? terms[i] : nullptr;
+                Explain->addStep(operation, term ? term->field : "", term ? term->key : "", -1, size,
+                                 QueryExplain::secondsSince(start));
+            }
+        };
+
+        // Start with the first map (restricted to the date range) and find intersections with other maps
+        auto start = explainStart();
+        map<string, int> result = hasDateFilter ? filterByDate(vectorOfMaps[0]) : vectorOfMaps[0];
+        explainStep(hasDateFilter ? "date-filter" : "start", explainedMaps, 0, result.size(), start);
         for (size_t i = 1; i < vectorOfMaps.size(); ++i) {
+            start = explainStart();
             result = intersectMaps(result, vectorOfMaps[i]);
+            explainStep("intersect", explainedMaps, i, result.size(), start);
         }
 
         // Exclude results from bad maps
-        for (const auto& badMap : vectorOfBadMaps) {
-            result = excludeMaps(result, badMap);
+        for (size_t i = 0; i < vectorOfBadMaps.size(); ++i) {
+            start = explainStart();
+            result = excludeMaps(result, vectorOfBadMaps[i]);
+            explainStep("exclude", explainedBadMaps, i, result.size(), start);
         }
         return result;
     }
 
-    // Sorts the document-frequency pairs in descending order by frequency
+    // Prepares ranking by frequency boosted by the static quality prior; pages are ranked on demand
     void sortDocumentsByFrequency(const map<string, int>& documentFrequencyMap) {
+        collectCandidates(documentFrequencyMap);
+        documentFrequencyPairs.clear();
+        rankingPending = !candidates().empty();
+    }
+
+    // Sorts the document-frequency pairs newest first by publication date
+    void sortDocumentsByDate(const map<string, int>& documentFrequencyMap) {
+        collectCandidates(documentFrequencyMap);
+        vector<pair<int, int>> byDate = rankCandidates;
+        sort(byDate.begin(), byDate.end(), [this](const pair<int, int>& a, const pair<int, int>& b) {
+            long long publishedA = Documents.getPublished(a.first);
+            long long publishedB = Documents.getPublished(b.first);
+            return publishedA != publishedB ? publishedA > publishedB : a.first < b.first;
+        });
+
         documentFrequencyPairs.clear();
+        for (const auto& candidate : byDate) {
+            documentFrequencyPairs.emplace_back(Documents.getName(candidate.first), candidate.second);
+        }
+        rankingPending = false;
+    }
+
+    // Resolves matched documents to IDs. The table is read only, so concurrent queries may share it;
+    // every document in the loaded trees was added to it at load time.
+    void collectCandidates(const map<string, int>& documentFrequencyMap) {
+        rankCandidates.clear();
+        rankCandidates.reserve(documentFrequencyMap.size());
+        rankedPostings = nullptr;
+        maxCandidateFrequency = 0;
         for (const auto& pair : documentFrequencyMap) {
-            documentFrequencyPairs.push_back(pair);
+            int docID = Documents.getID(pair.first);
+            if (docID >= 0) {
+                rankCandidates.emplace_back(docID, pair.second);
+                maxCandidateFrequency = max(maxCandidateFrequency, pair.second);
+            }
+        }
+    }
+
+    // Ranks the best `numDocuments` candidates into documentFrequencyPairs with a heap bounded by
+    // `numDocuments`. Ranked postings are visited in descending static score, so once the best
+    // possible score of the next one cannot beat the current top results, the rest are skipped.
+    void rankTopDocuments(size_t numDocuments) {
+        Trace::Span span("rankTopDocuments", "query");
+        if (numDocuments == 0) {
+            return;
+        }
+        const vector<pair<int, int>>& ranked = candidates();
+        auto isBetter = [&ranked](const pair<double, size_t>& a, const pair<double, size_t>& b) {
+            return a.first > b.first || (a.first == b.first && ranked[a.second].first < ranked[b.second].first);
+        };
+        bool canStopEarly = rankedPostings != nullptr && Documents.isStaticOrdered();
+
+        // Heap of (score, candidate index) whose front is the worst of the current top results
+        vector<pair<double, size_t>> top;
+        top.reserve(numDocuments);
+        size_t scanned = 0;
+        for (; scanned < ranked.size(); ++scanned) {
+            double boost = 1.0 + STATIC_WEIGHT * Documents.getStaticScore(ranked[scanned].first);
+            if (canStopEarly && top.size() == numDocuments && maxCandidateFrequency * boost <= top.front().first) {
+                break;
+            }
+
+            pair<double, size_t> scored(ranked[scanned].second * boost, scanned);
+            if (top.size() < numDocuments) {
+                top.push_back(scored);
+                push_heap(top.begin(), top.end(), isBetter);
+            } else if (isBetter(scored, top.front())) {
+                pop_heap(top.begin(), top.end(), isBetter);
+                top.back() = scored;
+                push_heap(top.begin(), top.end(), isBetter);
+            }
+        }
+        sort_heap(top.begin(), top.end(), isBetter);
+
+        documentFrequencyPairs.clear();
+        for (const auto& scored : top) {
+            const auto& candidate = ranked[scored.second];
+            documentFrequencyPairs.emplace_back(Documents.getName(candidate.first), candidate.second);
+        }
+        rankingPending = documentFrequencyPairs.size() < ranked.size();
+    }
+
+    // Counts the documents matching a query without materializing, sorting or printing them
+    size_t countQuery(const string& search) {
+        Trace::Span span("countQuery", "query", &search);
+        AllocationTracker::Scope allocations(AllocationTracker::QUERY);
+        auto start = explainStart();
+        if (Explain != nullptr) {
+            Explain->reset(search, "count");
+        }
+        clearQuery();
+        parseQuery(search);
+
+        // Counts one set of trees, recording it as a step when explaining
+        auto countIn = [this](AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words,
+                              const string& scope) {
+            auto countStart = explainStart();
+            size_t matches = countMatches(person, org, words);
+            if (Explain != nullptr) {
+                Explain->setScope(scope);
+                Explain->addStep("count", "", "", -1, matches, QueryExplain::secondsSince(countStart));
+                Explain->setScope("");
+            }
+            return matches;
+        };
+
+        bool hasPositiveTerm = false;
+        for (const auto& term : queryTerms) {
+            hasPositiveTerm = hasPositiveTerm || !term.excluded;
+        }
+        size_t total = 0;
+        if (!hasPositiveTerm) {
+            // A date filter on its own matches every document in the range
+            total = hasDateFilter ? static_cast<size_t>(count(dateFilter.begin(), dateFilter.end(), true)) : 0;
+        } else if (Partitions == nullptr) {
+            total = countIn(PersonTree, OrganizationTree, WordsTree, "");
+        } else {
+            // Partitions hold disjoint documents, so their counts add up
+            for (auto* partition : Partitions->overlapping(dateFrom, dateTo, false)) {
+                total += countIn(partition->PersonTree, partition->OrganizationTree, partition->WordsTree, partition->key);
+            }
         }
-        sort(documentFrequencyPairs.begin(), documentFrequencyPairs.end(),
-                  [](const pair<string, int>& a, const pair<string, int>& b) {
-                      return a.second > b.second;
-                  });
+        if (Explain != nullptr) {
+            Explain->setEvaluationSeconds(QueryExplain::secondsSince(start));
+        }
+        return total;
+    }
+
+    // Counts the matches of the parsed query in one set of trees by streaming the rarest
+    // positive posting list and probing the others in place; no posting list is copied
+    size_t countMatches(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words) {
+        const map<string, int>* rarest = nullptr;
+        vector<const map<string, int>*> required;
+        vector<const map<string, int>*> excluded;
+        for (const auto& term : queryTerms) {
+            AvlTree<string>& tree = term.field == "ORG" ? org : term.field == "PERSON" ? person : words;
+            auto node = tree.findNode(term.key);
+            if (term.excluded) {
+                if (node != nullptr) {
+                    excluded.push_back(&node->wordMap);
+                }
+                continue;
+            }
+            if (node == nullptr) {
+                return 0;
+            }
+            required.push_back(&node->wordMap);
+            if (rarest == nullptr || node->stats.documentFrequency < static_cast<int>(rarest->size())) {
+                rarest = &node->wordMap;
+            }
+        }
+
+        // A single term without other constraints is answered from the dictionary alone
+        if (required.size() == 1 && excluded.empty() && !hasDateFilter) {
+            return rarest->size();
+        }
+
+        size_t matches = 0;
+        for (const auto& posting : *rarest) {
+            if (hasDateFilter) {
+                int docID = Documents.getID(posting.first);
+                if (docID < 0 || !dateFilter[docID]) {
+                    continue;
+                }
+            }
+            bool matched = true;
+            for (const auto* postings : required) {
+                matched = matched && (postings == rarest || postings->count(posting.first) != 0);
+            }
+            for (const auto* postings : excluded) {
+                matched = matched && postings->count(posting.first) == 0;
+            }
+            matches += matched;
+        }
+        return matches;
+    }
+
+    // Ranks the top `numDocuments` of a word query from champion lists. Only the champions of each
+    // term are scored, so this returns false (leaving the full evaluation to the caller) unless the
+    // stored bounds prove that no other document can reach the top results.
+    bool rankFromChampions(const string& search, size_t numDocuments) {
+        Trace::Span span("rankFromChampions", "query");
+        if (Champions == nullptr || Partitions != nullptr || newestFirst || numDocuments == 0) {
+            return false;
+        }
+        parseQuery(search);
+
+        // Every positive term must be a word; excluded terms are checked by lookup in their tree
+        struct TermPostings {
+            const map<string, int>* wordMap;              // Full postings, read in place for lookups
+            const ChampionLists::ChampionList* champions; // nullptr if the full list is short
+            double bestScore;                             // Best single-term score of any document
+        };
+        vector<TermPostings> positives;
+        vector<const map<string, int>*> excluded;
+        for (const auto& term : queryTerms) {
+            AvlTree<string>& tree = term.field == "ORG" ? OrganizationTree : term.field == "PERSON" ? PersonTree : WordsTree;
+            auto node = tree.findNode(term.key);
+            if (term.excluded) {
+                if (node != nullptr) {
+                    excluded.push_back(&node->wordMap);
+                }
+                continue;
+            }
+            if (term.field != "WORD") {
+                return false;
+            }
+            if (node == nullptr) {
+                championSearch = search; // A missing term matches nothing, which is exact
+                return true;
+            }
+            TermPostings postings{&node->wordMap, Champions->find(term.key), 0};
+            if (postings.champions != nullptr) {
+                const auto& best = postings.champions->champions.front();
+                postings.bestScore = ChampionLists::score(Documents, best.first, best.second, STATIC_WEIGHT);
+            } else {
+                for (const auto& posting : node->wordMap) {
+                    postings.bestScore = max(postings.bestScore,
+                                             ChampionLists::score(Documents, posting.first, posting.second, STATIC_WEIGHT));
+                }
+            }
+            positives.push_back(postings);
+        }
+        if (positives.empty()) {
+            return false;
+        }
+
+        // Upper bound on the score of a matching document that is not a champion of some term
+        double bestSum = 0;
+        for (const auto& postings : positives) {
+            bestSum += postings.bestScore;
+        }
+        bool unseenPossible = false;
+        double unseenBound = 0;
+        for (const auto& postings : positives) {
+            if (postings.champions != nullptr) {
+                unseenPossible = true;
+                unseenBound = max(unseenBound, bestSum - postings.bestScore + postings.champions->bestOtherScore);
+            }
+        }
+
+        // Candidates are the champions (or whole short lists) of every term
+        vector<string> candidates;
+        for (const auto& postings : positives) {
+            if (postings.champions != nullptr) {
+                for (const auto& champion : postings.champions->champions) {
+                    candidates.push_back(champion.first);
+                }
+            } else {
+                for (const auto& posting : *postings.wordMap) {
+                    candidates.push_back(posting.first);
+                }
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+        // Score candidates that match every term, pass the date filter and are not excluded
+        vector<pair<double, pair<int, int>>> scored;  // (score, (document ID, frequency))
+        for (const auto& name : candidates) {
+            int frequency = 0;
+            bool matches = true;
+            for (const auto& postings : positives) {
+                auto found = postings.wordMap->find(name);
+                if (found == postings.wordMap->end()) {
+                    matches = false;
+                    break;
+                }
+                frequency += found->second;
+            }
+            for (const auto* badMap : excluded) {
+                matches = matches && badMap->find(name) == badMap->end();
+            }
+            int docID = Documents.getID(name);
+            if (!matches || docID < 0 || (hasDateFilter && !dateFilter[docID])) {
+                continue;
+            }
+            scored.push_back({ChampionLists::score(Documents, name, frequency, STATIC_WEIGHT), {docID, frequency}});
+        }
+        sort(scored.begin(), scored.end(), [](const pair<double, pair<int, int>>& a, const pair<double, pair<int, int>>& b) {
+            return a.first > b.first || (a.first == b.first && a.second.first < b.second.first);
+        });
+
+        // The page is exact only if every unseen document scores strictly below the last result
+        if (unseenPossible && (scored.size() < numDocuments || scored[numDocuments - 1].first <= unseenBound)) {
+            return false;
+        }
+
+        documentFrequencyPairs.clear();
+        for (size_t i = 0; i < scored.size() && i < numDocuments; ++i) {
+            documentFrequencyPairs.emplace_back(Documents.getName(scored[i].second.first), scored[i].second.second);
+        }
+        championSearch = search;
+        return true;
+    }
+
+    // Replaces a champion-only page with the full evaluation of the same query, keeping the page position
+    void ensureFullResults() {
+        if (championSearch.empty()) {
+            return;
+        }
+        string search = championSearch;
+        size_t position = searchIndex;
+        clearQuery();
+        map<string, int> result = processQuery(search);
+        sortDocumentsByFrequency(result);
+        rankTopDocuments(position);
+        searchIndex = position;
     }
 
     // Outputs the top `numDocuments` by relevance
     void outputDocuments(int numDocuments) {
+        Trace::Span span("outputDocuments", "query");
+        AllocationTracker::Scope allocations(AllocationTracker::QUERY);
         int count = 0;
+
+        // Pages past the champion-only answer need the full evaluation
+        if (!championSearch.empty() && searchIndex > 0) {
+            ensureFullResults();
+        }
         size_t startIndex = searchIndex;
 
+        // Rank further pages only when they are requested
+        if (rankingPending && startIndex + numDocuments > documentFrequencyPairs.size()) {
+            auto rankingStart = explainStart();
+            rankTopDocuments(startIndex + numDocuments);
+            if (Explain != nullptr) {
+                Explain->addRanking(getRankedCount(), QueryExplain::secondsSince(rankingStart));
+            }
+        }
+
         if (startIndex >= documentFrequencyPairs.size()) {
             cout << "No documents match the search criteria." << endl;
             return;
         }
 
         // Output documents starting from the current index
+        auto outputStart = explainStart();
         while (startIndex < documentFrequencyPairs.size() && count < numDocuments) {
             const auto& pair = documentFrequencyPairs[startIndex];
             cout << count + 1 << ". ";
@@ -101,31 +694,232 @@ class QueryProcessor {
             ++startIndex;
         }
         searchIndex = startIndex;
+        if (Explain != nullptr) {
+            Explain->addOutput(count, QueryExplain::secondsSince(outputStart));
+        }
+    }
+
+    // Counts matches per value of a facet field over the current result set, most frequent first
+    vector<pair<string, int>> facetCounts(const string& field) const {
+        const DocumentTable::FacetColumn* column = Documents.getFacet(field);
+        if (column == nullptr) {
+            return {};
+        }
+
+        // The matched documents are already resolved to IDs, so count codes with a flat array
+        vector<int> counts(column->dictionary.size(), 0);
+        const uint32_t* starts = column->starts.data();
+        const uint32_t* values = column->values.data();
+        for (const auto& candidate : candidates()) {
+            int docID = candidate.first;
+            for (uint32_t i = starts[docID]; i < starts[docID + 1]; ++i) {
+                ++counts[values[i]];
+            }
+        }
+
+        vector<pair<string, int>> facetPairs;
+        for (size_t code = 0; code < counts.size(); ++code) {
+            if (counts[code] > 0) {
+                facetPairs.emplace_back(column->dictionary[code], counts[code]);
+            }
+        }
+        sort(facetPairs.begin(), facetPairs.end(), [](const pair<string, int>& a, const pair<string, int>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return facetPairs;
+    }
+
+    // Outputs the top `numValues` counts of every facet field for the current result set
+    void outputFacets(size_t numValues = 10) {
+        AllocationTracker::Scope allocations(AllocationTracker::QUERY);
+        ensureFullResults(); // Facets count every match, not only the champions
+        for (const auto& field : DocumentTable::facetFields()) {
+            vector<pair<string, int>> counts = facetCounts(field);
+            cout << "Facet " << field << ":" << endl;
+            for (size_t i = 0; i < counts.size() && i < numValues; ++i) {
+                cout << "  " << counts[i].first << " (" << counts[i].second << ")" << endl;
+            }
+        }
     }
 
-    // Tokenizes and classifies search terms
+    // Tokenizes and classifies search terms, then fetches their maps from the shared trees
     void SeperateString(string search) {
-        string tempWord = "";
+        parseQuery(search);
+        fetchTermMaps(PersonTree, OrganizationTree, WordsTree);
+    }
+
+    // Tokenizes the query into classified terms and sets any date filter
+    void parseQuery(const string& search) {
         vector<string> wordsToSearch = DocumentParser::tokenizer(search);
+        bool explaining = Explain != nullptr && !Explain->hasTerms(); // A query parsed again is recorded once
 
-        for (auto& word : wordsToSearch) {
+        for (size_t i = 0; i < wordsToSearch.size(); ++i) {
+            string word = wordsToSearch[i];
+
+            // "date:[from TO to]" spans several tokens, so gather it before punctuation is stripped
+            if (word.substr(0, 6) == "date:[") {
+                string range = word.substr(6);
+                while (range.find(']') == string::npos && i + 1 < wordsToSearch.size()) {
+                    range += " " + wordsToSearch[++i];
+                }
+                setDateFilter(range.substr(0, range.find(']')));
+                if (explaining) {
+                    Explain->addTerm("date:[" + range, "", "", false, "date filter");
+                }
+                continue;
+            }
+
+            // "recent:<days>" keeps documents published within that many days of the newest document
+            if (word.substr(0, 7) == "recent:") {
+                setRecentFilter(word.substr(7));
+                if (explaining) {
+                    Explain->addTerm(word, "", "", false, "recency filter");
+                }
+                continue;
+            }
+
+            string typed = word;
             word = removePunctuationExcept(word);
+            size_t termsBefore = queryTerms.size();
 
             if (word.substr(0, 4) == "ORG:") {
-                tempWord = word.substr(4);
-                vectorOfMaps.push_back(OrganizationTree.getWordMapAtKey(tempWord));
+                queryTerms.push_back({"ORG", word.substr(4), false});
             } else if (word.substr(0, 7) == "PERSON:") {
-                tempWord = DocumentParser::toLower(word.substr(7));
-                vectorOfMaps.push_back(PersonTree.getWordMapAtKey(tempWord));
+                queryTerms.push_back({"PERSON", DocumentParser::toLower(word.substr(7)), false});
             } else if (word.substr(0, 1) == "-") {
-                tempWord = DocumentParser::stemWord(word.substr(1));
-                vectorOfBadMaps.push_back(WordsTree.getWordMapAtKey(tempWord));
+                queryTerms.push_back({"WORD", DocumentParser::stemWord(word.substr(1)), true});
             } else if (!DocumentParser::containsStopWords(word) && !word.empty()) {
-                vectorOfMaps.push_back(WordsTree.getWordMapAtKey(DocumentParser::stemWord(word)));
+                // Generated stop words are stems, so check the stemmed form as well
+                string stem = DocumentParser::stemWord(word);
+                if (!DocumentParser::containsStopWords(stem)) {
+                    queryTerms.push_back({"WORD", stem, false});
+                }
+            }
+
+            if (explaining && queryTerms.size() > termsBefore) {
+                const QueryTerm& term = queryTerms.back();
+                Explain->addTerm(typed, term.field, term.key, term.excluded);
+            } else if (explaining) {
+                Explain->addTerm(typed, "", "", false, word.empty() ? "dropped: only punctuation" : "dropped: stop word");
             }
         }
     }
 
+    // Fetches the document map of every parsed term from the given trees. Positive terms are
+    // fetched rarest first, using the document frequency stored in the dictionary, so the
+    // intersection starts from the shortest list; a term no document contains ends the fetch early.
+    void fetchTermMaps(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words) {
+        auto treeFor = [&](const QueryTerm& term) -> AvlTree<string>& {
+            return term.field == "ORG" ? org : term.field == "PERSON" ? person : words;
+        };
+
+        vector<pair<int, const QueryTerm*>> positives;
+        for (const auto& term : queryTerms) {
+            if (!term.excluded) {
+                positives.emplace_back(treeFor(term).getTermStats(term.key).documentFrequency, &term);
+            }
+        }
+        stable_sort(positives.begin(), positives.end(),
+                    [](const pair<int, const QueryTerm*>& a, const pair<int, const QueryTerm*>& b) { return a.first < b.first; });
+        if (!positives.empty() && positives.front().first == 0) {
+            vectorOfMaps.emplace_back();
+            if (Explain != nullptr) {
+                const QueryTerm& missing = *positives.front().second;
+                Explain->addStep("stop", missing.field, missing.key, 0, 0, 0);
+            }
+            return;
+        }
+
+        for (const auto& positive : positives) {
+            auto start = explainStart();
+            vectorOfMaps.push_back(treeFor(*positive.second).getWordMapAtKey(positive.second->key));
+            if (Explain != nullptr) {
+                explainedMaps.push_back(positive.second);
+                Explain->addStep("fetch", positive.second->field, positive.second->key, positive.first,
+                                 vectorOfMaps.back().size(), QueryExplain::secondsSince(start));
+            }
+        }
+        for (const auto& term : queryTerms) {
+            if (term.excluded) {
+                auto start = explainStart();
+                vectorOfBadMaps.push_back(treeFor(term).getWordMapAtKey(term.key));
+                if (Explain != nullptr) {
+                    explainedBadMaps.push_back(&term);
+                    Explain->addStep("exclude-fetch", term.field, term.key, treeFor(term).getTermStats(term.key).documentFrequency,
+                                     vectorOfBadMaps.back().size(), QueryExplain::secondsSince(start));
+                }
+            }
+        }
+    }
+
+    // Parses "from TO to" (dates, full timestamps or '*' for an open end) into the date filter bitset
+    void setDateFilter(const string& range) {
+        vector<string> bounds;
+        for (const auto& token : DocumentParser::tokenizer(range)) {
+            if (!token.empty() && token != "TO" && token != "to") {
+                bounds.push_back(token);
+            }
+        }
+        if (bounds.size() != 2) {
+            cerr << "Invalid date filter, expected date:[from TO to]: " << range << endl;
+            return;
+        }
+
+        long long from = bounds[0] == "*" ? DocumentTable::NO_TIMESTAMP : DocumentTable::parseTimestamp(bounds[0]);
+        long long to = bounds[1] == "*" ? DocumentTable::NO_TIMESTAMP : DocumentTable::parseTimestamp(bounds[1]);
+        if ((bounds[0] != "*" && from == DocumentTable::NO_TIMESTAMP) ||
+            (bounds[1] != "*" && to == DocumentTable::NO_TIMESTAMP)) {
+            cerr << "Invalid date in filter: " << range << endl;
+            return;
+        }
+        if (bounds[1] != "*" && bounds[1].size() <= 10) {
+            to += 86400 - 1; // A plain end date includes the whole day
+        }
+        applyDateRange(from, to);
+    }
+
+    // Parses a "recent:<days>" limit relative to the newest indexed document
+    void setRecentFilter(const string& days) {
+        long long latest = Documents.getLatestPublished();
+        if (days.empty() || !all_of(days.begin(), days.end(), ::isdigit) || latest == DocumentTable::NO_TIMESTAMP) {
+            cerr << "Invalid recency limit, expected recent:<days>: " << days << endl;
+            return;
+        }
+        applyDateRange(latest - stoll(days) * 86400, DocumentTable::NO_TIMESTAMP);
+    }
+
+    // Stores the date bounds (NO_TIMESTAMP for an open end) and builds the date filter bitset
+    void applyDateRange(long long from, long long to) {
+        dateFrom = from;
+        dateTo = to;
+        dateFilter = Documents.publishedBetween(from == DocumentTable::NO_TIMESTAMP ? from + 1 : from,
+                                                to == DocumentTable::NO_TIMESTAMP ? numeric_limits<long long>::max() : to);
+        hasDateFilter = true;
+    }
+
+    // Keeps only the documents whose publication date passes the date filter
+    map<string, int> filterByDate(const map<string, int>& docMap) const {
+        map<string, int> filtered;
+        for (const auto& pair : docMap) {
+            int docID = Documents.getID(pair.first);
+            if (docID >= 0 && dateFilter[docID]) {
+                filtered.insert(filtered.end(), pair);
+            }
+        }
+        return filtered;
+    }
+
+    // Lists every document that passes the date filter, for queries with no other terms
+    map<string, int> documentsInDateRange() const {
+        map<string, int> inRange;
+        for (size_t docID = 0; docID < dateFilter.size(); ++docID) {
+            if (dateFilter[docID]) {
+                inRange.emplace(Documents.getName(static_cast<int>(docID)), 0);
+            }
+        }
+        return inRange;
+    }
+
     // Finds the intersection of two maps
     map<string, int> intersectMaps(map<string, int>& map1, map<string, int>& map2) {
         map<string, int> intersectMap;
@@ -141,9 +935,9 @@ class QueryProcessor {
     }
 
     // Excludes keys from the map that exist in badMap
-    map<string, int> excludeMaps(const map<string, int>& map, const map<string, int>& badMap) {
+    map<string, int> excludeMaps(const map<string, int>& docMap, const map<string, int>& badMap) {
         map<string, int> excludeMap;
-        for (const auto& pair : map) {
+        for (const auto& pair : docMap) {
             if (badMap.find(pair.first) == badMap.end()) {
                 excludeMap.insert(pair);
             }
@@ -162,11 +956,30 @@ class QueryProcessor {
         return word;
     }
 
-    // Reads tree data from files
-    void getTreesfromFile(const string& personFile, const string& orgFile, const string& wordFile) {
+    // Reads tree data and the document table from files
+    void getTreesfromFile(const string& personFile, const string& orgFile, const string& wordFile,
+                          const string& documentFile) {
+        Trace::Span span("loadIndex", "query");
+        AllocationTracker::Scope allocations(AllocationTracker::LOAD);
         PersonTree.readFromTextFile(personFile);
         OrganizationTree.readFromTextFile(orgFile);
         WordsTree.readFromTextFile(wordFile);
+        Documents.readFromTextFile(documentFile);
+
+        addMissingDocuments(PersonTree);
+        addMissingDocuments(OrganizationTree);
+        addMissingDocuments(WordsTree);
+        buildRankedPostings();
+    }
+
+    // Gives documents of a loaded tree that are missing from the table (e.g. an index written without
+    // one) an ID at load time, so queries only read the table and may share it across threads
+    void addMissingDocuments(const AvlTree<string>& tree) {
+        tree.forEachNode([this](const string&, const map<string, int>& wordMap) {
+            for (const auto& posting : wordMap) {
+                Documents.addDocument(posting.first);
+            }
+        });
     }
 
     // Retrieves the document name at the specified index
@@ -179,5 +992,3 @@ class QueryProcessor {
 };
 
 #endif // QUERY_PROCESSOR_H
-
-#endif
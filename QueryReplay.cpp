@@ -0,0 +1,301 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include "AllocationTracker.h"
+#include "AvlTree.h"
+#include "ChampionLists.h"
+#include "DocumentParser.h"
+#include "DocumentTable.h"
+#include "LatencyHistogram.h"
+#include "PerfCounters.h"
+#include "QueryProcessor.h"
+#include "TimePartitionedIndex.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Query classes reported separately, in report order
+enum QueryClass { SINGLE_TERM, AND, EXCLUSION, ENTITY, QUERY_CLASS_COUNT };
+static const char* const QUERY_CLASS_NAMES[QUERY_CLASS_COUNT] = {"single_term", "and", "exclusion", "entity"};
+
+/**
+ * @brief Classifies a query by its terms; date filters do not count as terms.
+ *        Entity prefixes take precedence over exclusions, and exclusions over plain AND.
+ */
+static QueryClass classifyQuery(const string& query) {
+    size_t positiveTerms = 0;
+    bool excluded = false;
+    bool entity = false;
+    for (const auto& token : DocumentParser::tokenizer(query)) {
+        if (token.empty() || token.rfind("date:", 0) == 0 || token.rfind("recent:", 0) == 0 ||
+            token == "TO" || token.back() == ']') {
+            continue;
+        }
+        string term = token[0] == '-' ? token.substr(1) : token;
+        entity = entity || term.rfind("ORG:", 0) == 0 || term.rfind("PERSON:", 0) == 0;
+        if (token[0] == '-') {
+            excluded = true;
+        } else {
+            ++positiveTerms;
+        }
+    }
+    return entity ? ENTITY : excluded ? EXCLUSION : positiveTerms > 1 ? AND : SINGLE_TERM;
+}
+
+/**
+ * @brief Latencies recorded by one client.
+ */
+struct ClientResult {
+    LatencyHistogram overall;
+    LatencyHistogram byClass[QUERY_CLASS_COUNT];
+    PerfCounters::Counts counters;  // Hardware counts of the client's thread over its whole replay
+    string countersUnavailable;     // Why the counters could not be opened, if they could not
+};
+
+/**
+ * @brief Prints one histogram as a report row, in microseconds.
+ */
+static void printRow(const string& name, const LatencyHistogram& histogram) {
+    cout << left << setw(14) << name << right << setw(10) << histogram.getCount() << fixed << setprecision(1)
+         << setw(11) << histogram.getMean() / 1000 << setw(11) << histogram.percentile(50) / 1000.0 << setw(11)
+         << histogram.percentile(99) / 1000.0 << setw(11) << histogram.percentile(99.9) / 1000.0 << setw(11)
+         << histogram.getMax() / 1000.0 << "\n";
+    cout.unsetf(ios::floatfield);
+}
+
+/**
+ * @brief Writes one histogram as a JSON object, in nanoseconds.
+ */
+static void writeJsonStats(ostream& out, const LatencyHistogram& histogram) {
+    out << "{\"count\": " << histogram.getCount() << ", \"mean_ns\": " << histogram.getMean()
+        << ", \"min_ns\": " << histogram.getMin() << ", \"p50_ns\": " << histogram.percentile(50)
+        << ", \"p90_ns\": " << histogram.percentile(90) << ", \"p99_ns\": " << histogram.percentile(99)
+        << ", \"p999_ns\": " << histogram.percentile(99.9) << ", \"max_ns\": " << histogram.getMax() << "}";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage:\n"
+             << argv[0] << " <query-log> [--clients=<n>] [--repeat=<passes>] [--json=<file>] [--index=<directory>]\n"
+             << "      [--trace=<json-file>]\n";
+        return 1;
+    }
+
+    string logFile = argv[1];
+    string indexDirectory = "Trees";
+    string jsonFile;
+    string traceFile;
+    int clients = 1;
+    int repeat = 1;
+    for (int i = 2; i < argc; ++i) {
+        string option = argv[i];
+        string value = option.substr(option.find('=') + 1);
+        if (option.rfind("--clients=", 0) == 0) {
+            clients = max(1, stoi(value));
+        } else if (option.rfind("--repeat=", 0) == 0) {
+            repeat = max(1, stoi(value));
+        } else if (option.rfind("--json=", 0) == 0) {
+            jsonFile = value;
+        } else if (option.rfind("--index=", 0) == 0) {
+            indexDirectory = value;
+        } else if (option.rfind("--trace=", 0) == 0) {
+            traceFile = value;
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 1;
+        }
+    }
+
+    // Read the query log, one query per line
+    vector<string> queries;
+    vector<QueryClass> classes;
+    ifstream log(logFile);
+    if (!log) {
+        cerr << "Error: Unable to open file " << logFile << " for reading." << endl;
+        return 1;
+    }
+    for (string line; getline(log, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            queries.push_back(line);
+            classes.push_back(classifyQuery(line));
+        }
+    }
+    if (queries.empty()) {
+        cerr << "No queries in " << logFile << endl;
+        return 1;
+    }
+
+    // Load the index once; every client shares the trees and document table
+    AvlTree<string> PersonTree;
+    AvlTree<string> OrganizationTree;
+    AvlTree<string> WordsTree;
+    DocumentTable Documents;
+    TimePartitionedIndex Partitions;
+    ChampionLists Champions;
+    auto loadStart = chrono::steady_clock::now();
+    QueryProcessor loader(PersonTree, OrganizationTree, WordsTree, Documents);
+    loader.getTreesfromFile(indexDirectory + "/personTree.txt", indexDirectory + "/organizationTree.txt",
+                            indexDirectory + "/wordsTree.txt", indexDirectory + "/documentTable.txt");
+    DocumentParser::loadStopWords("stopWords.txt");
+    if (filesystem::exists(indexDirectory + "/generatedStopWords.txt")) {
+        DocumentParser::loadStopWords(indexDirectory + "/generatedStopWords.txt");
+    }
+    bool partitioned = filesystem::is_directory(indexDirectory + "/partitions");
+    if (partitioned) {
+        Partitions.readFromDirectory(indexDirectory + "/partitions");
+    }
+    bool hasChampions = filesystem::exists(indexDirectory + "/champions.txt");
+    if (hasChampions) {
+        Champions.readFromTextFile(indexDirectory + "/champions.txt");
+    }
+    chrono::duration<double> loadDuration = chrono::steady_clock::now() - loadStart;
+    cout << "Index loaded in " << loadDuration.count() << " seconds.\n";
+
+    // Each client evaluates queries with its own processor, since a processor holds per-query state
+    vector<unique_ptr<QueryProcessor>> processors;
+    for (int client = 0; client < clients; ++client) {
+        processors.push_back(make_unique<QueryProcessor>(PersonTree, OrganizationTree, WordsTree, Documents));
+        if (partitioned) {
+            processors.back()->setPartitionedIndex(&Partitions);
+        }
+        if (hasChampions) {
+            processors.back()->setChampionLists(&Champions);
+        }
+    }
+
+    // Queries only read the shared document table: every indexed document got its ID while loading.
+    // One untimed pass warms caches and settles every lazily built structure before clients share them
+    for (const auto& query : queries) {
+        processors[0]->evaluateQuery(query, 15);
+    }
+    Documents.prepareForConcurrentReads();
+
+    // The timeline covers the measured replay only
+    if (!traceFile.empty()) {
+        Trace::enable();
+    }
+
+    // Clients take the next query from a shared cursor until the log has been replayed `repeat` times
+    size_t totalQueries = queries.size() * repeat;
+    atomic<size_t> cursor(0);
+    vector<ClientResult> results(clients);
+    auto runClient = [&](int client) {
+        QueryProcessor& processor = *processors[client];
+        ClientResult& result = results[client];
+        Trace::setThreadName("client " + to_string(client));
+        PerfCounters perf;  // Counts this thread only
+        result.countersUnavailable = perf.getUnavailableReason();
+        PerfCounters::Counts before = perf.read();
+        for (size_t i = cursor++; i < totalQueries; i = cursor++) {
+            size_t index = i % queries.size();
+            auto start = chrono::steady_clock::now();
+            processor.evaluateQuery(queries[index], 15);
+            uint64_t nanoseconds = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            result.overall.record(nanoseconds);
+            result.byClass[classes[index]].record(nanoseconds);
+        }
+        result.counters.addDelta(before, perf.read());
+    };
+
+    AllocationTracker::Counts allocationsBefore = AllocationTracker::snapshot();
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int client = 1; client < clients; ++client) {
+        threads.emplace_back(runClient, client);
+    }
+    runClient(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+    AllocationTracker::Counts allocations = AllocationTracker::snapshot().since(allocationsBefore);
+
+    ClientResult merged;
+    for (const auto& result : results) {
+        merged.overall.merge(result.overall);
+        merged.counters.add(result.counters);
+        for (int queryClass = 0; queryClass < QUERY_CLASS_COUNT; ++queryClass) {
+            merged.byClass[queryClass].merge(result.byClass[queryClass]);
+        }
+    }
+
+    double qps = totalQueries / wall.count();
+    cout << "Replayed " << totalQueries << " queries with " << clients << " client(s) in " << wall.count()
+         << " seconds (" << qps << " QPS).\n";
+    cout << left << setw(14) << "class" << right << setw(10) << "queries" << setw(11) << "mean us" << setw(11)
+         << "p50" << setw(11) << "p99" << setw(11) << "p99.9" << setw(11) << "max" << "\n";
+    printRow("all", merged.overall);
+    for (int queryClass = 0; queryClass < QUERY_CLASS_COUNT; ++queryClass) {
+        if (merged.byClass[queryClass].getCount() > 0) {
+            printRow(QUERY_CLASS_NAMES[queryClass], merged.byClass[queryClass]);
+        }
+    }
+
+    if (merged.counters.any()) {
+        cout << "Per query:";
+        for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+            if (merged.counters.available[event]) {
+                cout << " " << PerfCounters::eventName(static_cast<PerfCounters::Event>(event)) << " "
+                     << static_cast<uint64_t>(merged.counters.values[event] / totalQueries);
+            }
+        }
+        cout << ", IPC " << merged.counters.instructionsPerCycle() << "\n";
+    } else {
+        cout << "Hardware counters unavailable (" << results[0].countersUnavailable << ").\n";
+    }
+
+    if (AllocationTracker::isEnabled()) {
+        AllocationTracker::printTable(cout, allocations, totalQueries, "query");
+    }
+
+    if (!traceFile.empty()) {
+        if (!Trace::writeToFile(traceFile)) {
+            cerr << "Error: Unable to open file " << traceFile << " for writing." << endl;
+            return 1;
+        }
+        cout << "Trace with " << Trace::getEventCount() << " spans written to " << traceFile << "\n";
+    }
+
+    if (!jsonFile.empty()) {
+        ofstream out(jsonFile);
+        if (!out) {
+            cerr << "Error: Unable to open file " << jsonFile << " for writing." << endl;
+            return 1;
+        }
+        out << "{\n  \"queries\": " << totalQueries << ",\n  \"clients\": " << clients
+            << ",\n  \"wall_seconds\": " << wall.count() << ",\n  \"qps\": " << qps << ",\n  \"all\": ";
+        writeJsonStats(out, merged.overall);
+        out << ",\n  \"counters_per_query\": {";
+        for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+            out << (event == 0 ? "" : ", ") << "\"" << PerfCounters::eventName(static_cast<PerfCounters::Event>(event))
+                << "\": ";
+            if (merged.counters.available[event]) {
+                out << merged.counters.values[event] / totalQueries;
+            } else {
+                out << "null";
+            }
+        }
+        out << "}";
+        if (AllocationTracker::isEnabled()) {
+            out << ",\n  \"allocations_per_query\": " << static_cast<double>(allocations.totalAllocations()) / totalQueries
+                << ",\n  \"allocated_bytes_per_query\": " << static_cast<double>(allocations.totalBytes()) / totalQueries;
+        }
+        out << ",\n  \"classes\": {";
+        bool first = true;
+        for (int queryClass = 0; queryClass < QUERY_CLASS_COUNT; ++queryClass) {
+            out << (first ? "\n" : ",\n") << "    \"" << QUERY_CLASS_NAMES[queryClass] << "\": ";
+            writeJsonStats(out, merged.byClass[queryClass]);
+            first = false;
+        }
+        out << "\n  }\n}\n";
+        cout << "Results written to " << jsonFile << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+#ifndef SPIMI_INDEXER_H
+#define SPIMI_INDEXER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "AvlTree.h"
+#include "Trace.h"
+
+using namespace std;
+
+/**
+ * @class SpimiIndexer
+ * @brief Single-pass in-memory indexing under a memory budget, for corpora larger than RAM.
+ * Documents are indexed into the in-memory trees as usual. Whenever the trees' estimated
+ * heap size reaches the budget, they are written to disk as sorted runs (one file per tree)
+ * and emptied. When indexing ends, the runs of each tree are k-way merged into the final
+ * index file. Merging streams one line per run, so only the current key's postings are held.
+ * The budget covers the three trees only. The document table stays in memory, and it is
+ * small next to the postings.
+ */
+class SpimiIndexer {
+   public:
+    // Documents indexed between memory checks right after a flush; later checks adapt to the growth rate
+    static constexpr size_t MIN_CHECK_INTERVAL = 16;
+
+    // Tree names, used in run file names and reports, in the order the trees are passed in
+    enum TreeKind { PERSONS, ORGANIZATIONS, WORDS, TREE_COUNT };
+
+    /**
+     * @struct MergeStats
+     * @brief What finish() produced.
+     */
+    struct MergeStats {
+        size_t runs = 0;                // Sorted runs flushed, including the final partial one
+        size_t terms[TREE_COUNT] = {};  // Distinct keys in each merged index file
+        double mergeSeconds = 0;
+    };
+
+   private:
+    string runDirectory;
+    size_t memoryBudget;
+    size_t runCount = 0;
+    size_t documentsInRun = 0;
+    size_t documentsSinceCheck = 0;
+    size_t documentsUntilCheck = MIN_CHECK_INTERVAL;
+    size_t peakEstimate = 0;
+
+    /**
+     * @struct RunLine
+     * @brief One parsed "key:df,cf,maxTf:(doc,freq)..." line of a sorted run.
+     */
+    struct RunLine {
+        string key;
+        long long documentFrequency = 0;
+        long long collectionFrequency = 0;
+        long long maxTermFrequency = 0;
+        string postings;  // The "(doc,freq)..." text, copied through unparsed
+    };
+
+    /**
+     * @brief Reads the next line of a run. Runs are written by AvlTree::writeSortedToTextFile, so
+     *        every line carries its statistics.
+     * @return False at the end of the run or on a malformed line.
+     */
+    static bool readRunLine(ifstream& in, RunLine& line) {
+        string text;
+        if (!getline(in, text)) {
+            return false;
+        }
+        size_t keyEnd = text.find(':');
+        size_t statsEnd = keyEnd == string::npos ? string::npos : text.find(':', keyEnd + 1);
+        if (statsEnd == string::npos) {
+            cerr << "Error: Invalid run format: " << text.substr(0, 80) << endl;
+            return false;
+        }
+        line.key = text.substr(0, keyEnd);
+        if (sscanf(text.c_str() + keyEnd + 1, "%lld,%lld,%lld", &line.documentFrequency, &line.collectionFrequency,
+                   &line.maxTermFrequency) != 3) {
+            cerr << "Error: Invalid run statistics for key " << line.key << endl;
+            return false;
+        }
+        line.postings = text.substr(statsEnd + 1);
+        return true;
+    }
+
+    string runFile(size_t run, TreeKind tree) const {
+        static const char* const names[TREE_COUNT] = {"person", "organization", "words"};
+        char number[24];  // Room for any size_t
+        snprintf(number, sizeof(number), "%05zu", run);
+        return runDirectory + "/run_" + number + "_" + names[tree] + ".txt";
+    }
+
+    /**
+     * @brief Copies lines [lo, hi) of a key-ordered file to `out` middle first, then the lower and
+     *        upper halves the same way: the pre-order of a balanced tree, which
+     *        AvlTree::readFromTextFile rebuilds without rotations.
+     * @param offsets The byte offset of every line of `in`.
+     */
+    static void writePreOrder(ifstream& in, const vector<uint64_t>& offsets, size_t lo, size_t hi, ofstream& out,
+                              string& line) {
+        if (lo >= hi) {
+            return;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        in.clear();
+        in.seekg(static_cast<streamoff>(offsets[mid]));
+        getline(in, line);
+        out << line << "\n";
+        writePreOrder(in, offsets, lo, mid, out, line);
+        writePreOrder(in, offsets, mid + 1, hi, out, line);
+    }
+
+    static size_t estimateBytes(const AvlTree<string>& person, const AvlTree<string>& org,
+                                const AvlTree<string>& words) {
+        return person.memoryUsage().totalBytes() + org.memoryUsage().totalBytes() + words.memoryUsage().totalBytes();
+    }
+
+   public:
+    /**
+     * @param directory Where sorted runs are written; created if missing, and removed after the merge.
+     * @param budgetBytes Estimated heap bytes the trees may hold before they are flushed.
+     */
+    SpimiIndexer(const string& directory, size_t budgetBytes) : runDirectory(directory), memoryBudget(budgetBytes) {}
+
+    /**
+     * @brief Merges sorted runs of one tree into a single index file. Documents never span runs, so
+     *        the postings of a key are concatenated and its statistics combine exactly. The runs are
+     *        merged in key order into a temporary file, which is then copied out in the pre-order
+     *        of a balanced tree, like AvlTree::writeToTextFile, so loading the index does not
+     *        rebalance on every insert. Only one byte offset per key is held in memory.
+     * @param runFiles The sorted runs.
+     * @param outputFile The merged index file, readable by AvlTree::readFromTextFile.
+     * @return The number of distinct keys written.
+     */
+    static size_t mergeRuns(const vector<string>& runFiles, const string& outputFile) {
+        string sortedFile = outputFile + ".sorted";
+        ofstream sorted(sortedFile, ios::binary);
+        if (!sorted) {
+            cerr << "Error: Unable to open file " << sortedFile << " for writing." << endl;
+            return 0;
+        }
+        vector<unique_ptr<ifstream>> inputs;
+        vector<RunLine> heads(runFiles.size());
+        auto laterKey = [&heads](size_t a, size_t b) { return heads[b].key < heads[a].key; };
+        priority_queue<size_t, vector<size_t>, decltype(laterKey)> queue(laterKey);
+        for (size_t run = 0; run < runFiles.size(); ++run) {
+            inputs.push_back(make_unique<ifstream>(runFiles[run]));
+            if (readRunLine(*inputs.back(), heads[run])) {
+                queue.push(run);
+            }
+        }
+
+        vector<uint64_t> offsets;
+        uint64_t offset = 0;
+        string text;
+        while (!queue.empty()) {
+            size_t run = queue.top();
+            queue.pop();
+            RunLine merged = move(heads[run]);
+            if (readRunLine(*inputs[run], heads[run])) {
+                queue.push(run);
+            }
+            while (!queue.empty() && heads[queue.top()].key == merged.key) {
+                size_t other = queue.top();
+                queue.pop();
+                merged.documentFrequency += heads[other].documentFrequency;
+                merged.collectionFrequency += heads[other].collectionFrequency;
+                merged.maxTermFrequency = max(merged.maxTermFrequency, heads[other].maxTermFrequency);
+                merged.postings += heads[other].postings;
+                if (readRunLine(*inputs[other], heads[other])) {
+                    queue.push(other);
+                }
+            }
+            text = merged.key + ":" + to_string(merged.documentFrequency) + "," +
+                   to_string(merged.collectionFrequency) + "," + to_string(merged.maxTermFrequency) + ":" +
+                   merged.postings + "\n";
+            sorted << text;
+            offsets.push_back(offset);
+            offset += text.size();
+        }
+        sorted.close();
+
+        ifstream in(sortedFile, ios::binary);
+        ofstream out(outputFile);
+        if (!in || !out) {
+            cerr << "Error: Unable to open file " << outputFile << " for writing." << endl;
+            filesystem::remove(sortedFile);
+            return 0;
+        }
+        writePreOrder(in, offsets, 0, offsets.size(), out, text);
+        in.close();
+        filesystem::remove(sortedFile);
+        return offsets.size();
+    }
+
+    /**
+     * @brief Called after each indexed document; flushes the trees once they reach the budget.
+     *        Measuring walks the trees, so the next measurement is scheduled when three quarters of
+     *        the room left should be used at the run's average growth per document. Growth slows
+     *        as the vocabulary saturates, so the average overestimates it and the budget is
+     *        approached from below in a few measurements per run.
+     * @return True if the trees were flushed.
+     */
+    bool afterDocument(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words) {
+        ++documentsInRun;
+        if (++documentsSinceCheck < documentsUntilCheck) {
+            return false;
+        }
+        documentsSinceCheck = 0;
+        size_t used = estimateBytes(person, org, words);
+        if (used >= memoryBudget) {
+            peakEstimate = max(peakEstimate, used);
+            flush(person, org, words);
+            return true;
+        }
+        double bytesPerDocument = static_cast<double>(used) / documentsInRun;
+        size_t documentsLeft = bytesPerDocument > 0 ? static_cast<size_t>((memoryBudget - used) / bytesPerDocument) : 0;
+        documentsUntilCheck = max(MIN_CHECK_INTERVAL, documentsLeft * 3 / 4);
+        return false;
+    }
+
+    /**
+     * @brief Writes the trees as the next sorted run and empties them.
+     * @return False if a run file could not be written.
+     */
+    bool flush(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words) {
+        if (person.isEmpty() && org.isEmpty() && words.isEmpty()) {
+            return true;
+        }
+        Trace::Span span("flushRun", "index");
+        filesystem::create_directories(runDirectory);
+        AvlTree<string>* trees[TREE_COUNT] = {&person, &org, &words};
+        bool written = true;
+        for (int tree = 0; tree < TREE_COUNT; ++tree) {
+            written = trees[tree]->writeSortedToTextFile(runFile(runCount, static_cast<TreeKind>(tree))) && written;
+            trees[tree]->makeEmpty();
+        }
+        ++runCount;
+        documentsInRun = 0;
+        documentsSinceCheck = 0;
+        documentsUntilCheck = MIN_CHECK_INTERVAL;
+        return written;
+    }
+
+    /**
+     * @brief Flushes what is left in the trees, merges every run into the final index files and
+     *        removes the runs.
+     * @return The number of runs and the distinct keys per merged file.
+     */
+    MergeStats finish(AvlTree<string>& person, AvlTree<string>& org, AvlTree<string>& words,
+                      const string& personFile, const string& orgFile, const string& wordFile) {
+        MergeStats stats;
+        peakEstimate = max(peakEstimate, estimateBytes(person, org, words));
+        flush(person, org, words);
+        stats.runs = runCount;
+
+        Trace::Span span("mergeRuns", "index");
+        auto start = chrono::steady_clock::now();
+        const string outputs[TREE_COUNT] = {personFile, orgFile, wordFile};
+        for (int tree = 0; tree < TREE_COUNT; ++tree) {
+            vector<string> runFiles;
+            for (size_t run = 0; run < runCount; ++run) {
+                runFiles.push_back(runFile(run, static_cast<TreeKind>(tree)));
+            }
+            stats.terms[tree] = mergeRuns(runFiles, outputs[tree]);
+            for (const auto& file : runFiles) {
+                filesystem::remove(file);
+            }
+        }
+        stats.mergeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        error_code ignored;
+        filesystem::remove(runDirectory, ignored);  // Only succeeds if nothing else was left there
+        runCount = 0;
+        return stats;
+    }
+
+    /**
+     * @brief Returns the number of runs flushed so far.
+     */
+    size_t getRunCount() const {
+        return runCount;
+    }
+
+    /**
+     * @brief Returns the largest tree estimate measured before a flush, to compare against the budget.
+     */
+    size_t getPeakEstimate() const {
+        return peakEstimate;
+    }
+
+    size_t getMemoryBudget() const {
+        return memoryBudget;
+    }
+};
+
+#endif  // SPIMI_INDEXER_H
@@ -0,0 +1,214 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "AvlTree.h"
+#include "Benchmark.h"
+#include "DirectoryWalker.h"
+#include "DocumentParser.h"
+#include "DocumentTable.h"
+#include "QueryProcessor.h"
+
+using namespace std;
+
+// Number of distinct keys and documents used by the synthetic tree and map benchmarks
+static const size_t NUM_KEYS = 20000;
+static const size_t NUM_DOCUMENTS = 20000;
+
+/**
+ * @brief Builds deterministic lowercase pseudo-words so tree benchmarks do not depend on the corpus.
+ */
+static vector<string> makeKeys(size_t count) {
+    vector<string> keys;
+    keys.reserve(count);
+    unsigned long long state = 0x2545f4914f6cdd1dULL;
+    for (size_t i = 0; i < count; ++i) {
+        string key;
+        size_t length = 4 + i % 7;
+        for (size_t j = 0; j < length; ++j) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key += static_cast<char>('a' + (state >> 33) % 26);
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+/**
+ * @brief Reads every JSON article under a directory into memory.
+ */
+static vector<string> loadArticles(const string& directory) {
+    vector<string> articles;
+    if (!filesystem::is_directory(directory)) {
+        return articles;
+    }
+    for (const auto& entry : filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            ifstream input(entry.path());
+            stringstream buffer;
+            buffer << input.rdbuf();
+            articles.push_back(buffer.str());
+        }
+    }
+    return articles;
+}
+
+int main(int argc, char* argv[]) {
+    string jsonFile;
+    string dataDirectory = "sample_data";
+    int repetitions = 30;
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option.rfind("--json=", 0) == 0) {
+            jsonFile = option.substr(7);
+        } else if (option.rfind("--repetitions=", 0) == 0) {
+            repetitions = stoi(option.substr(14));
+        } else if (option.rfind("--data=", 0) == 0) {
+            dataDirectory = option.substr(7);
+        } else {
+            cerr << "Usage:\n" << argv[0] << " [--json=<file>] [--repetitions=<n>] [--data=<directory>]\n";
+            return 1;
+        }
+    }
+
+    Benchmark bench(3, repetitions);
+    DocumentParser::loadStopWords("stopWords.txt");
+
+    // AvlTree hot paths
+    vector<string> keys = makeKeys(NUM_KEYS);
+    bench.run("avl_insert", keys.size(), [&] {
+        AvlTree<string> tree;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(keys[i], "doc" + to_string(i % 64), 1);
+        }
+        Benchmark::doNotOptimize(tree);
+    });
+
+    AvlTree<string> tree;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(keys[i], "doc" + to_string(i % 64), 1);
+    }
+    bench.run("avl_contains", keys.size(), [&] {
+        size_t found = 0;
+        for (const auto& key : keys) {
+            found += tree.contains(key);
+        }
+        Benchmark::doNotOptimize(found);
+    });
+    bench.run("avl_getWordMapAtKey", keys.size(), [&] {
+        size_t postings = 0;
+        for (const auto& key : keys) {
+            postings += tree.getWordMapAtKey(key).size();
+        }
+        Benchmark::doNotOptimize(postings);
+    });
+
+    // Analyzer stages over the text of the sample articles
+    vector<string> articles = loadArticles(dataDirectory);
+    string text;
+    for (const auto& article : articles) {
+        Document document;
+        document.Parse(article.c_str());
+        if (!document.HasParseError() && document.HasMember("text") && document["text"].IsString()) {
+            text += document["text"].GetString();
+            text += " ";
+        }
+    }
+    vector<string> tokens = DocumentParser::tokenizer(text);
+    vector<string> words;
+    for (const auto& token : tokens) {
+        string word = DocumentParser::toLower(DocumentParser::removePunctuation(token));
+        if (!word.empty()) {
+            words.push_back(word);
+        }
+    }
+
+    if (articles.empty()) {
+        cerr << "No articles found in " << dataDirectory << "; skipping analyzer and JSON benchmarks.\n";
+    } else {
+        bench.run("tokenizer", tokens.size(), [&] {
+            vector<string> result = DocumentParser::tokenizer(text);
+            Benchmark::doNotOptimize(result);
+        });
+        bench.run("removePunctuation", tokens.size(), [&] {
+            size_t length = 0;
+            for (const auto& token : tokens) {
+                length += DocumentParser::removePunctuation(token).size();
+            }
+            Benchmark::doNotOptimize(length);
+        });
+        bench.run("stemWord", words.size(), [&] {
+            size_t length = 0;
+            for (const auto& word : words) {
+                length += DocumentParser::stemWord(word).size();
+            }
+            Benchmark::doNotOptimize(length);
+        });
+        bench.run("containsStopWords", words.size(), [&] {
+            size_t stopWords = 0;
+            for (const auto& word : words) {
+                stopWords += DocumentParser::containsStopWords(word);
+            }
+            Benchmark::doNotOptimize(stopWords);
+        });
+        bench.run("json_parse", articles.size(), [&] {
+            size_t members = 0;
+            for (const auto& article : articles) {
+                Document document;
+                document.Parse(article.c_str());
+                members += document.IsObject() ? document.MemberCount() : 0;
+            }
+            Benchmark::doNotOptimize(members);
+        });
+
+        // Enumerating the corpus directory, serially and with the parallel walker
+        size_t fileCount = 0;
+        for (const auto& entry : filesystem::recursive_directory_iterator(dataDirectory)) {
+            fileCount += entry.is_regular_file();
+        }
+        bench.run("walk_recursive_iterator", fileCount, [&] {
+            size_t found = 0;
+            for (const auto& entry : filesystem::recursive_directory_iterator(dataDirectory)) {
+                found += entry.is_regular_file();
+            }
+            Benchmark::doNotOptimize(found);
+        });
+        bench.run("walk_directory_walker", fileCount, [&] {
+            DirectoryWalker walker(dataDirectory, DirectoryWalker::DEFAULT_THREADS);
+            size_t found = 0;
+            for (string path; walker.next(path);) {
+                ++found;
+            }
+            Benchmark::doNotOptimize(found);
+        });
+    }
+
+    // Posting-list intersection of two lists that share half their documents
+    AvlTree<string> person, org, wordsTree;
+    DocumentTable documents;
+    QueryProcessor queryProcessor(person, org, wordsTree, documents);
+    map<string, int> left, right, rightCopy;
+    for (size_t i = 0; i < NUM_DOCUMENTS; ++i) {
+        left["doc" + to_string(i)] = 1;
+        right["doc" + to_string(i + NUM_DOCUMENTS / 2)] = 1;
+    }
+    bench.run(
+        "intersectMaps", left.size() + right.size(),
+        [&] {
+            map<string, int> result = queryProcessor.intersectMaps(left, rightCopy);
+            Benchmark::doNotOptimize(result);
+        },
+        [&] { rightCopy = right; }); // intersectMaps consumes its second argument
+
+    bench.printTable(cout);
+    if (!jsonFile.empty()) {
+        ofstream output(jsonFile);
+        if (!output) {
+            cerr << "Error: Unable to open file " << jsonFile << " for writing." << endl;
+            return 1;
+        }
+        bench.writeJson(output);
+        cout << "Results written to " << jsonFile << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+#ifndef TIME_PARTITIONED_INDEX_H
+#define TIME_PARTITIONED_INDEX_H
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AvlTree.h"
+#include "DocumentTable.h"
+
+using namespace std;
+
+/**
+ * @class TimePartitionedIndex
+ * @brief Splits the index into one set of AVL trees per publication month, so queries
+ * restricted to a time window (or looking only for recent news) can skip every partition
+ * that cannot contain a match instead of scanning postings for the whole archive.
+ */
+class TimePartitionedIndex {
+   public:
+    /**
+     * @struct Partition
+     * @brief The person, organization and word trees for documents published in one month.
+     */
+    struct Partition {
+        string key;                        // "YYYY-MM", or UNDATED_KEY for documents without a date
+        long long firstPublished;          // Inclusive start of the month (seconds since epoch, UTC)
+        long long lastPublished;           // Inclusive end of the month
+        AvlTree<string> PersonTree;
+        AvlTree<string> OrganizationTree;
+        AvlTree<string> WordsTree;
+    };
+
+    // Partition key used for documents whose publication date could not be parsed
+    static constexpr const char* UNDATED_KEY = "undated";
+
+   private:
+    // Partitions ordered by key, which for "YYYY-MM" keys is also chronological order
+    map<string, Partition> partitions;
+
+    /**
+     * @brief Creates an empty partition and computes its time bounds from the key.
+     */
+    Partition& createPartition(const string& key) {
+        Partition& partition = partitions[key];
+        partition.key = key;
+        if (key == UNDATED_KEY) {
+            partition.firstPublished = DocumentTable::NO_TIMESTAMP;
+            partition.lastPublished = DocumentTable::NO_TIMESTAMP;
+            return partition;
+        }
+
+        int year = stoi(key.substr(0, 4));
+        int month = stoi(key.substr(5, 2));
+        partition.firstPublished = DocumentTable::parseTimestamp(monthKey(year, month) + "-01");
+        partition.lastPublished = month == 12
+                                      ? DocumentTable::parseTimestamp(monthKey(year + 1, 1) + "-01") - 1
+                                      : DocumentTable::parseTimestamp(monthKey(year, month + 1) + "-01") - 1;
+        return partition;
+    }
+
+    /**
+     * @brief Formats a year and month as a "YYYY-MM" partition key.
+     */
+    static string monthKey(int year, int month) {
+        string key = to_string(year) + "-";
+        if (month < 10) {
+            key += "0";
+        }
+        return key + to_string(month);
+    }
+
+   public:
+    /**
+     * @brief Returns the partition for a publication timestamp, creating it if needed.
+     * @param published The publication time, or DocumentTable::NO_TIMESTAMP.
+     * @return The partition that owns documents published at that time.
+     */
+    Partition& partitionFor(long long published) {
+        string key = UNDATED_KEY;
+        if (published != DocumentTable::NO_TIMESTAMP) {
+            // Convert days since epoch back to a civil year and month
+            long long z = (published >= 0 ? published : published - 86399) / 86400 + 719468;
+            long long era = (z >= 0 ? z : z - 146096) / 146097;
+            long long doe = z - era * 146097;
+            long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            long long mp = (5 * doy + 2) / 153;
+            int month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+            int year = static_cast<int>(yoe + era * 400 + (month <= 2));
+            key = monthKey(year, month);
+        }
+
+        auto found = partitions.find(key);
+        return found != partitions.end() ? found->second : createPartition(key);
+    }
+
+    /**
+     * @brief Selects the partitions that may hold documents published in [from, to].
+     *        Undated documents can only match when there is no date restriction.
+     * @param from Inclusive lower bound, or DocumentTable::NO_TIMESTAMP for no bound.
+     * @param to Inclusive upper bound, or DocumentTable::NO_TIMESTAMP for no bound.
+     * @param newestFirst If true, the partitions are returned newest first.
+     * @return Pointers to the overlapping partitions.
+     */
+    vector<Partition*> overlapping(long long from, long long to, bool newestFirst) {
+        bool restricted = from != DocumentTable::NO_TIMESTAMP || to != DocumentTable::NO_TIMESTAMP;
+        vector<Partition*> selected;
+        for (auto& entry : partitions) {
+            Partition& partition = entry.second;
+            if (partition.key == UNDATED_KEY) {
+                if (!restricted) {
+                    selected.push_back(&partition);
+                }
+                continue;
+            }
+            if (from != DocumentTable::NO_TIMESTAMP && partition.lastPublished < from) {
+                continue;
+            }
+            if (to != DocumentTable::NO_TIMESTAMP && partition.firstPublished > to) {
+                continue;
+            }
+            selected.push_back(&partition);
+        }
+
+        if (newestFirst) {
+            // Keep undated documents last when searching newest first
+            auto undated = selected.end();
+            if (!selected.empty() && selected.back()->key == UNDATED_KEY) {
+                undated = selected.end() - 1;
+            }
+            reverse(selected.begin(), undated);
+        }
+        return selected;
+    }
+
+    /**
+     * @brief Returns the number of partitions.
+     */
+    size_t getSize() const {
+        return partitions.size();
+    }
+
+    /**
+     * @brief Returns true if no document has been indexed into a partition.
+     */
+    bool isEmpty() const {
+        return partitions.empty();
+    }
+
+    /**
+     * @brief Clears all partitions.
+     */
+    void makeEmpty() {
+        partitions.clear();
+    }
+
+    /**
+     * @brief Writes every partition's trees to "<directory>/<key>/".
+     * @param directory The directory that holds one subdirectory per partition.
+     */
+    void writeToDirectory(const string& directory) const {
+        for (const auto& entry : partitions) {
+            string folder = directory + "/" + entry.first;
+            filesystem::create_directories(folder);
+            entry.second.PersonTree.writeToTextFile(folder + "/personTree.txt");
+            entry.second.OrganizationTree.writeToTextFile(folder + "/organizationTree.txt");
+            entry.second.WordsTree.writeToTextFile(folder + "/wordsTree.txt");
+        }
+    }
+
+    /**
+     * @brief Reads partitions written by writeToDirectory, replacing the current contents.
+     * @param directory The directory that holds one subdirectory per partition.
+     */
+    void readFromDirectory(const string& directory) {
+        makeEmpty();
+        if (!filesystem::is_directory(directory)) {
+            cerr << "Error: Unable to open partition directory " << directory << endl;
+            return;
+        }
+        for (const auto& entry : filesystem::directory_iterator(directory)) {
+            if (!entry.is_directory()) {
+                continue;
+            }
+            string key = entry.path().filename().string();
+            if (key != UNDATED_KEY && DocumentTable::parseTimestamp(key + "-01") == DocumentTable::NO_TIMESTAMP) {
+                continue; // Not a partition folder
+            }
+            string folder = entry.path().string();
+            Partition& partition = createPartition(key);
+            partition.PersonTree.readFromTextFile(folder + "/personTree.txt");
+            partition.OrganizationTree.readFromTextFile(folder + "/organizationTree.txt");
+            partition.WordsTree.readFromTextFile(folder + "/wordsTree.txt");
+        }
+    }
+};
+
+#endif  // TIME_PARTITIONED_INDEX_H
@@ -0,0 +1,222 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "JsonEscape.h"
+
+using namespace std;
+
+/**
+ * @class Trace
+ * @brief A timeline of what each thread was doing, written in the Chrome Trace Event format
+ * so it can be opened in chrome://tracing or Perfetto. Every thread appends completed spans to
+ * its own buffer without locking; the buffers are registered once per thread and stay alive
+ * until the trace is written. While tracing is disabled a span costs one relaxed atomic load.
+ */
+class Trace {
+   public:
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * @struct Event
+     * @brief One completed span, in nanoseconds since tracing was enabled.
+     */
+    struct Event {
+        const char* name;      // Static strings only, so recording never copies them
+        const char* category;
+        uint64_t startNs;
+        uint64_t durationNs;
+        string detail;         // Optional argument shown with the span, such as a document or query
+    };
+
+   private:
+    /**
+     * @struct ThreadBuffer
+     * @brief The spans recorded by one thread.
+     */
+    struct ThreadBuffer {
+        uint32_t threadId;
+        string threadName;
+        vector<Event> events;
+    };
+
+    /**
+     * @struct State
+     * @brief Process-wide tracing state: the switch, the time origin and every thread's buffer.
+     */
+    struct State {
+        atomic<bool> enabled{false};
+        Clock::time_point origin;
+        mutex registryMutex;
+        vector<unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    /**
+     * @brief Returns the calling thread's buffer, registering it on first use.
+     */
+    static ThreadBuffer& localBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            State& shared = state();
+            lock_guard<mutex> lock(shared.registryMutex);
+            shared.buffers.push_back(make_unique<ThreadBuffer>());
+            buffer = shared.buffers.back().get();
+            buffer->threadId = static_cast<uint32_t>(shared.buffers.size());
+        }
+        return *buffer;
+    }
+
+   public:
+    /**
+     * @brief Starts recording spans on every thread; timestamps are relative to this call.
+     */
+    static void enable() {
+        State& shared = state();
+        shared.origin = Clock::now();
+        shared.enabled.store(true, memory_order_release);
+    }
+
+    /**
+     * @brief Returns true while spans are being recorded.
+     */
+    static bool isEnabled() {
+        return state().enabled.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Names the calling thread in the timeline.
+     */
+    static void setThreadName(const string& name) {
+        if (isEnabled()) {
+            localBuffer().threadName = name;
+        }
+    }
+
+    /**
+     * @brief Records a span that started at `start` and ends now.
+     * @param name A string literal naming the span.
+     * @param category A string literal grouping related spans.
+     * @param start When the span started; spans started before tracing was enabled are dropped.
+     * @param detail Optional text shown with the span.
+     */
+    static void complete(const char* name, const char* category, Clock::time_point start, string detail = "") {
+        if (!isEnabled()) {
+            return;
+        }
+        State& shared = state();
+        if (start < shared.origin) {
+            return;
+        }
+        Clock::time_point end = Clock::now();
+        uint64_t startNs = chrono::duration_cast<chrono::nanoseconds>(start - shared.origin).count();
+        uint64_t durationNs = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        localBuffer().events.push_back({name, category, startNs, durationNs, move(detail)});
+    }
+
+    /**
+     * @class Span
+     * @brief Records the lifetime of a scope as one span, if tracing is enabled when it opens.
+     */
+    class Span {
+        const char* name;
+        const char* category;
+        const string* detail;
+        Clock::time_point start;
+        bool active;
+
+       public:
+        /**
+         * @param name A string literal naming the span.
+         * @param category A string literal grouping related spans.
+         * @param detail Optional text shown with the span; it must outlive the span and is only copied when recording.
+         */
+        Span(const char* name, const char* category, const string* detail = nullptr)
+            : name(name), category(category), detail(detail), active(Trace::isEnabled()) {
+            if (active) {
+                start = Clock::now();
+            }
+        }
+
+        ~Span() {
+            if (active) {
+                Trace::complete(name, category, start, detail != nullptr ? *detail : string());
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    };
+
+    /**
+     * @brief Returns the number of spans recorded so far on all threads.
+     */
+    static size_t getEventCount() {
+        State& shared = state();
+        lock_guard<mutex> lock(shared.registryMutex);
+        size_t count = 0;
+        for (const auto& buffer : shared.buffers) {
+            count += buffer->events.size();
+        }
+        return count;
+    }
+
+    /**
+     * @brief Writes every recorded span as Chrome Trace Event JSON. Call it once the traced
+     *        threads have finished, since their buffers are read without synchronization.
+     */
+    static void writeJson(ostream& out) {
+        State& shared = state();
+        lock_guard<mutex> lock(shared.registryMutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        bool first = true;
+        out << fixed << setprecision(3);
+        for (const auto& buffer : shared.buffers) {
+            string threadName = buffer->threadName.empty() ? "thread " + to_string(buffer->threadId) : buffer->threadName;
+            out << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                << buffer->threadId << ", \"args\": {\"name\": \"" << JsonEscape::escape(threadName) << "\"}}";
+            first = false;
+            for (const auto& event : buffer->events) {
+                // Trace Event timestamps are microseconds
+                out << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                    << "\", \"ph\": \"X\", \"ts\": " << event.startNs / 1000.0 << ", \"dur\": " << event.durationNs / 1000.0
+                    << ", \"pid\": 1, \"tid\": " << buffer->threadId;
+                if (!event.detail.empty()) {
+                    out << ", \"args\": {\"detail\": \"" << JsonEscape::escape(event.detail) << "\"}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+    }
+
+    /**
+     * @brief Writes the trace to a file.
+     * @return False if the file could not be opened.
+     */
+    static bool writeToFile(const string& filePath) {
+        ofstream out(filePath);
+        if (!out) {
+            return false;
+        }
+        writeJson(out);
+        return true;
+    }
+};
+
+#endif  // TRACE_H
@@ -1,27 +1,65 @@
 #include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <filesystem>
+#include <sstream>
+#include "AllocationTracker.h"
 #include "AvlTree.h"
+#include "ChampionLists.h"
+#include "DirectoryWalker.h"
 #include "DocumentParser.h"
+#include "DocumentReorderer.h"
+#include "DocumentTable.h"
+#include "FilePrefetcher.h"
+#include "GzipSeekIndex.h"
+#include "IndexingProfile.h"
+#include "JsonRecordReader.h"
+#include "PerfCounters.h"
+#include "ProcessMemory.h"
+#include "QueryExplain.h"
 #include "QueryProcessor.h"
+#include "SpimiIndexer.h"
+#include "TimePartitionedIndex.h"
+#include "Trace.h"
 //referenced from G4G, DigitalOceans
 
 using namespace std;
 
 // Function to index all files in a given directory and output performance statistics.
-void indexDirectory(DocumentParser& docParse, AvlTree<string>& PersonTree, 
-                    AvlTree<string>& OrganizationTree, AvlTree<string>& WordsTree) {
+// JSON Lines files (and, with `concatenated`, every file) are indexed record by record.
+// The directory tree is enumerated by `walkThreads` threads while the files found so far are indexed.
+// Without a prefetch window, compressed articles are decompressed one file ahead on a worker thread.
+// With a `prefetchWindow`, that many files are hinted to the kernel and read ahead of the parser
+// (in inode order within each window, with `inodeOrder`), and documents are analyzed in parallel.
+// When a profile is given, also prints where the indexing time went. Returns the indexing time in seconds.
+double indexDirectory(DocumentParser& docParse, AvlTree<string>& PersonTree, 
+                    AvlTree<string>& OrganizationTree, AvlTree<string>& WordsTree,
+                    const IndexingProfile* profile = nullptr, bool concatenated = false,
+                    size_t walkThreads = DirectoryWalker::DEFAULT_THREADS, size_t prefetchWindow = 0,
+                    bool inodeOrder = false) {
     cout << "Enter the path to the directory to index: ";
     string input;
     cin >> input;
 
     auto start = chrono::high_resolution_clock::now();
+    AllocationTracker::Counts allocationsBefore = AllocationTracker::snapshot();
+
+    // Process files as the directory walker finds them.
+    DirectoryWalker walker(input, walkThreads);
+    if (prefetchWindow > 0) {
+        // Record files are streamed by the parser's own read-ahead, so the prefetcher leaves them unread
+        FilePrefetcher prefetcher(
+            walker, [concatenated](const string& path) { return concatenated || JsonRecordReader::isJsonLinesFile(path); },
+            prefetchWindow, inodeOrder);
+        docParse.runPrefetched(prefetcher, concatenated);
+    } else {
+        docParse.runWalk(walker, concatenated);
+    }
 
-    // Iterate over all files in the specified directory and process them.
-    for (const auto& entry : filesystem::recursive_directory_iterator(input)) {
-        if (entry.is_regular_file()) {
-            docParse.runDocument(entry.path().string());
-        }
+    // Reassign document IDs in descending static-score (quality) order.
+    {
+        Trace::Span span("finishIndexing", "index");
+        docParse.finishIndexing();
     }
 
     auto end = chrono::high_resolution_clock::now();
@@ -30,10 +68,178 @@ void indexDirectory(DocumentParser& docParse, AvlTree<string>& PersonTree,
     // Output indexing statistics.
     cout << "Indexing took " << duration.count() << " seconds.\n";
     cout << "Indexing completed.\n";
-    cout << "Unique names: " << PersonTree.getSize() << "\n";
-    cout << "Unique organizations: " << OrganizationTree.getSize() << "\n";
-    cout << "Unique words: " << WordsTree.getSize() << "\n";
+    if (!docParse.isIndexingToRuns()) { // Otherwise the trees hold only the last run until the merge
+        cout << "Unique names: " << PersonTree.getSize() << "\n";
+        cout << "Unique organizations: " << OrganizationTree.getSize() << "\n";
+        cout << "Unique words: " << WordsTree.getSize() << "\n";
+    }
     cout << "Files indexed: " << docParse.getFilesIndexed() << "\n";
+    if (profile != nullptr) {
+        profile->printTable(cout, duration.count());
+        cout << "Directories walked: " << walker.getDirectoriesRead() << " (entries needing a stat: "
+             << walker.getStatCalls() << ")\n";
+    }
+    if (AllocationTracker::isEnabled()) {
+        AllocationTracker::printTable(cout, AllocationTracker::snapshot().since(allocationsBefore),
+                                      docParse.getFilesIndexed(), "doc");
+    }
+
+    // Report documents dropped by the optional index-time filters.
+    int skipped = docParse.getSpamSkipped() + docParse.getDuplicatesSkipped() + docParse.getNearDuplicatesSkipped();
+    if (skipped > 0) {
+        cout << "Skipped as spam: " << docParse.getSpamSkipped() << "\n";
+        cout << "Skipped as exact duplicates: " << docParse.getDuplicatesSkipped() << "\n";
+        cout << "Skipped as near duplicates: " << docParse.getNearDuplicatesSkipped() << "\n";
+        cout << "Documents kept: " << docParse.getFilesIndexed() - skipped << " ("
+             << 100.0 * skipped / docParse.getFilesIndexed() << "% pruned)\n";
+        size_t tokens = docParse.getTokensIndexed() + docParse.getTokensSkipped();
+        cout << "Token occurrences indexed: " << docParse.getTokensIndexed() << " of " << tokens << " ("
+             << (tokens > 0 ? 100.0 * docParse.getTokensSkipped() / tokens : 0.0) << "% kept out of the index)\n";
+        cout << "Filter checks took " << docParse.getFilterSeconds() << " seconds.\n";
+    }
+    return duration.count();
+}
+
+// Function to pick the words found in the most documents, most common first, as single-term queries.
+vector<string> commonWordQueries(const vector<const AvlTree<string>*>& wordTrees, size_t count) {
+    unordered_map<string, size_t> docFrequency;
+    for (const auto* tree : wordTrees) {
+        tree->forEachNode([&docFrequency](const string& key, const map<string, int>& wordMap) {
+            docFrequency[key] += wordMap.size();
+        });
+    }
+    vector<pair<size_t, string>> commonTerms;
+    for (auto& term : docFrequency) {
+        commonTerms.emplace_back(term.second, term.first);
+    }
+    size_t sampleSize = min(count, commonTerms.size());
+    partial_sort(commonTerms.begin(), commonTerms.begin() + sampleSize, commonTerms.end(), greater<>());
+    vector<string> queries;
+    for (size_t i = 0; i < sampleSize; ++i) {
+        queries.push_back(commonTerms[i].second);
+    }
+    return queries;
+}
+
+// Function to time one evaluation of each query, in seconds.
+double timeQueries(QueryProcessor& queryProc, const vector<string>& queries) {
+    auto start = chrono::high_resolution_clock::now();
+    for (const auto& query : queries) {
+        queryProc.evaluateQuery(query, 15);
+    }
+    chrono::duration<double> duration = chrono::high_resolution_clock::now() - start;
+    queryProc.clearQuery();
+    return duration.count();
+}
+
+// Function to renumber the documents of a loaded index for better posting locality and report the effect.
+void reorderIndex(const string& method, QueryProcessor& queryProc, DocumentTable& Documents,
+                  AvlTree<string>& PersonTree, AvlTree<string>& OrganizationTree, AvlTree<string>& WordsTree) {
+    vector<const AvlTree<string>*> trees = {&PersonTree, &OrganizationTree, &WordsTree};
+
+    // Time the most common words as single-term queries before and after reordering.
+    vector<string> commonTerms = commonWordQueries({&WordsTree}, 50);
+
+    double bitsBefore = DocumentReorderer::bitsPerPosting(trees, Documents);
+    double queryBefore = timeQueries(queryProc, commonTerms);
+
+    auto start = chrono::high_resolution_clock::now();
+    // Ranking stops early only while IDs follow static score, so the locality order breaks ties.
+    vector<int> locality = method == "url" ? DocumentReorderer::orderByUrl(Documents)
+                                           : DocumentReorderer::orderByBisection(WordsTree, Documents);
+    Documents.applyOrder(DocumentReorderer::withinStaticScoreTies(locality, Documents));
+    chrono::duration<double> reorderTime = chrono::high_resolution_clock::now() - start;
+    queryProc.buildRankedPostings();
+
+    double bitsAfter = DocumentReorderer::bitsPerPosting(trees, Documents);
+    double queryAfter = timeQueries(queryProc, commonTerms);
+
+    // Output reordering statistics.
+    cout << "Reordering (" << method << ") took " << reorderTime.count() << " seconds.\n";
+    cout << "Documents: " << Documents.getSize() << " (sharing a static score, so free to move: "
+         << DocumentReorderer::countStaticScoreTies(Documents) << ")\n";
+    cout << "Estimated bits per posting if stored as gamma-coded docID gaps: " << bitsBefore << " -> " << bitsAfter
+         << "\n";
+    cout << "(The saved postings stay keyed by document path, so the index files do not shrink.)\n";
+    cout << commonTerms.size() << " common-term queries took: " << queryBefore << " -> " << queryAfter << " seconds\n";
+}
+
+// Function to print the estimated memory held by a loaded index, the process RSS and posting-list sizes.
+// Each row totals a group of trees, e.g. the words tree of every month partition.
+void printIndexStats(const vector<pair<string, vector<const AvlTree<string>*>>>& trees, const DocumentTable& Documents,
+                     size_t residentBeforeLoad) {
+    auto mib = [](size_t bytes) {
+        ostringstream text;
+        text << fixed << setprecision(2) << bytes / 1048576.0;
+        return text.str();
+    };
+
+    // Per-tree breakdown
+    vector<AvlTree<string>::MemoryUsage> usages;
+    size_t treeBytes = 0;
+    size_t postings = 0;
+    cout << "Estimated index memory (MiB):\n";
+    cout << left << setw(14) << "tree" << right << setw(10) << "keys" << setw(12) << "postings" << setw(10)
+         << "nodes" << setw(10) << "key text" << setw(10) << "postings" << setw(11) << "doc names" << setw(10)
+         << "ranked" << setw(10) << "total" << "\n";
+    for (const auto& tree : trees) {
+        usages.emplace_back();
+        auto& usage = usages.back();
+        for (const auto* part : tree.second) {
+            usage.add(part->memoryUsage());
+        }
+        treeBytes += usage.totalBytes();
+        postings += usage.postings;
+        cout << left << setw(14) << tree.first << right << setw(10) << usage.nodes << setw(12) << usage.postings
+             << setw(10) << mib(usage.nodeBytes) << setw(10) << mib(usage.keyBytes) << setw(10)
+             << mib(usage.postingBytes) << setw(11) << mib(usage.documentNameBytes) << setw(10)
+             << mib(usage.rankedPostingBytes) << setw(10) << mib(usage.totalBytes()) << "\n";
+    }
+
+    DocumentTable::MemoryUsage table = Documents.memoryUsage();
+    cout << "Document table (estimated MiB): names " << mib(table.nameBytes) << ", id index "
+         << mib(table.idIndexBytes) << ", columns " << mib(table.columnBytes) << ", facets " << mib(table.facetBytes)
+         << ", total " << mib(table.totalBytes()) << "\n";
+
+    size_t total = treeBytes + table.totalBytes();
+    cout << "Total estimated: " << mib(total) << " MiB\n";
+    size_t resident = ProcessMemory::currentResidentBytes();
+    cout << "Resident set (measured): " << mib(resident) << " MiB now, "
+         << mib(max(resident, ProcessMemory::peakResidentBytes())) << " MiB peak, " << mib(residentBeforeLoad)
+         << " MiB before loading\n";
+    if (Documents.getSize() > 0) {
+        cout << "Estimated per document: " << total / Documents.getSize() << " bytes\n";
+    }
+    if (postings > 0) {
+        cout << "Estimated per posting (trees only): " << treeBytes / postings << " bytes\n";
+    }
+
+    // Number of keys by posting-list length, in powers of two
+    size_t buckets = 0;
+    for (const auto& usage : usages) {
+        buckets = max(buckets, usage.postingListSizes.size());
+    }
+    cout << "Keys by posting-list length:\n" << left << setw(16) << "postings" << right;
+    for (const auto& tree : trees) {
+        cout << setw(14) << tree.first;
+    }
+    cout << "\n";
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        size_t low = size_t(1) << bucket;
+        cout << left << setw(16) << (bucket == 0 ? "1" : to_string(low) + "-" + to_string(2 * low - 1)) << right;
+        for (const auto& usage : usages) {
+            cout << setw(14) << (bucket < usage.postingListSizes.size() ? usage.postingListSizes[bucket] : 0);
+        }
+        cout << "\n";
+    }
+}
+
+// Function to load the standard stop words plus any generated by vocabulary pruning for an index.
+static void loadStopWordLists(const string& folderName) {
+    DocumentParser::loadStopWords("stopWords.txt");
+    if (filesystem::exists(folderName + "/generatedStopWords.txt")) {
+        DocumentParser::loadStopWords(folderName + "/generatedStopWords.txt");
+    }
 }
 
 // Function to handle query execution and display a query results menu.
@@ -57,6 +263,7 @@ void performQuery(QueryProcessor& queryProc, DocumentParser& docParse) {
         cout << "Press 'n' to print 5 more documents.\n";
         cout << "Press 'q' to start a new query.\n";
         cout << "Press 'd' and enter a document number to print its text.\n";
+        cout << "Press 'f' to show facet counts for the results.\n";
         cout << "Press 'e' to return to the main menu.\n";
         cout << "Enter your choice: ";
         cin >> userChoice;
@@ -86,6 +293,10 @@ void performQuery(QueryProcessor& queryProc, DocumentParser& docParse) {
                 break;
             }
 
+            case 'f':
+                queryProc.outputFacets();
+                break;
+
             case 'e':
                 return;  // Return to the main menu.
 
@@ -102,8 +313,9 @@ static void startUI() {
     AvlTree<string> PersonTree;
     AvlTree<string> OrganizationTree;
     AvlTree<string> WordsTree;
-    DocumentParser documentParser(PersonTree, OrganizationTree, WordsTree);
-    QueryProcessor queryProcessor(PersonTree, OrganizationTree, WordsTree);
+    DocumentTable Documents;
+    DocumentParser documentParser(PersonTree, OrganizationTree, WordsTree, Documents);
+    QueryProcessor queryProcessor(PersonTree, OrganizationTree, WordsTree, Documents);
 
     char userChoice;
 
@@ -135,7 +347,10 @@ static void startUI() {
                 filesystem::create_directories(folderName);
                 documentParser.toFile(folderName + "/personTree.txt", 
                                       folderName + "/organizationTree.txt", 
-                                      folderName + "/wordsTree.txt");
+                                      folderName + "/wordsTree.txt",
+                                      folderName + "/documentTable.txt");
+                documentParser.writeGeneratedStopWords(folderName + "/generatedStopWords.txt");
+                GzipSeekIndex::writeToFile(folderName + "/gzipSeekPoints.bin");
                 break;
             }
 
@@ -146,7 +361,10 @@ static void startUI() {
 
                 queryProcessor.getTreesfromFile(folderName + "/personTree.txt",
                                                 folderName + "/organizationTree.txt",
-                                                folderName + "/wordsTree.txt");
+                                                folderName + "/wordsTree.txt",
+                                                folderName + "/documentTable.txt");
+                loadStopWordLists(folderName);
+                GzipSeekIndex::readFromFile(folderName + "/gzipSeekPoints.bin");
                 break;
             }
 
@@ -165,8 +383,15 @@ int main(int argc, char* argv[]) {
     // Validate command-line arguments and initialize components.
     if (argc < 2) {
         cerr << "Usage:\n"
-             << argv[0] << " index <directory>\n"
-             << argv[0] << " query <query-string>\n"
+             << argv[0] << " index <directory> [--partitioned] [--max-spam=<score>] [--dedupe] [--near-dup=<similarity>]\n"
+             << "      [--min-df=<documents>] [--max-df-ratio=<fraction>] [--champions=<per-term>]\n"
+             << "      [--profile[=<json-file>]] [--perf] [--trace=<json-file>]\n"
+             << "      [--memory-budget=<MiB> [--run-dir=<directory>]] [--records] [--threads=<n>] [--walk-threads=<n>]\n"
+             << "      [--prefetch[=<files>] [--inode-order]]\n"
+             << argv[0] << " query <query-string> [--newest-first] [--facets] [--count] [--explain[=<json-file>]]\n"
+             << "      [--trace=<json-file>]\n"
+             << argv[0] << " reorder <url|bisect>\n"
+             << argv[0] << " stats\n"
              << argv[0] << " ui\n";
         return 1;
     }
@@ -174,32 +399,253 @@ int main(int argc, char* argv[]) {
     AvlTree<string> PersonTree;
     AvlTree<string> OrganizationTree;
     AvlTree<string> WordsTree;
-    DocumentParser documentParser(PersonTree, OrganizationTree, WordsTree);
-    QueryProcessor queryProcessor(PersonTree, OrganizationTree, WordsTree);
+    DocumentTable Documents;
+    DocumentParser documentParser(PersonTree, OrganizationTree, WordsTree, Documents);
+    QueryProcessor queryProcessor(PersonTree, OrganizationTree, WordsTree, Documents);
+    TimePartitionedIndex Partitions;
+    ChampionLists Champions;
 
     string command = argv[1];
 
+    // Optional flags that follow the positional arguments.
+    vector<string> options(argv + min(argc, 3), argv + argc);
+    auto hasOption = [&options](const string& flag) {
+        return find(options.begin(), options.end(), flag) != options.end();
+    };
+    auto optionValue = [&options](const string& flag) {
+        for (const auto& option : options) {
+            if (option.rfind(flag + "=", 0) == 0) {
+                return option.substr(flag.size() + 1);
+            }
+        }
+        return string();
+    };
+
+    // Record a timeline of the command when asked; spans cost almost nothing otherwise.
+    string traceFile = optionValue("--trace");
+    if (!traceFile.empty()) {
+        Trace::enable();
+        Trace::setThreadName("main");
+    }
+
     // Handle different modes of operation.
-    if (command == "index" && argc == 3) {
+    if (command == "index" && argc >= 3) {
         string directory = argv[2];
-        indexDirectory(documentParser, PersonTree, OrganizationTree, WordsTree);
-        documentParser.toFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt");
 
-    } else if (command == "query" && argc == 3) {
+        // Under a memory budget the index is built as sorted runs on disk, so steps that need the whole
+        // index in memory afterwards are not available.
+        bool budgeted = !optionValue("--memory-budget").empty();
+        if (budgeted && (hasOption("--partitioned") || !optionValue("--min-df").empty() ||
+                         !optionValue("--max-df-ratio").empty() || !optionValue("--champions").empty())) {
+            cerr << "--memory-budget cannot be combined with --partitioned, --min-df, --max-df-ratio or --champions.\n";
+            return 1;
+        }
+        string runDirectory = optionValue("--run-dir").empty() ? "Trees/runs" : optionValue("--run-dir");
+        SpimiIndexer spimi(runDirectory, budgeted ? static_cast<size_t>(stod(optionValue("--memory-budget")) * (1 << 20)) : 0);
+        if (budgeted) {
+            documentParser.setSpimiIndexer(&spimi);
+        }
+
+        if (hasOption("--partitioned")) {
+            documentParser.setPartitionedIndex(&Partitions);
+        }
+        if (!optionValue("--max-spam").empty()) {
+            documentParser.setSpamThreshold(stod(optionValue("--max-spam")));
+        }
+        documentParser.setExactDedupe(hasOption("--dedupe"));
+        if (!optionValue("--near-dup").empty()) {
+            documentParser.setNearDuplicateThreshold(stod(optionValue("--near-dup")));
+        }
+        if (!optionValue("--threads").empty()) {
+            documentParser.setAnalysisThreads(stoul(optionValue("--threads")));
+        }
+        IndexingProfile profile;
+        bool profiling = hasOption("--profile") || !optionValue("--profile").empty() || hasOption("--perf");
+        if (profiling) {
+            documentParser.setProfile(&profile);
+        }
+
+        // Hardware counters per phase; indexing runs on this thread, which is the one they count
+        // (the analysis threads of multi-document files and prefetched files are not counted).
+        PerfCounters perf;
+        if (hasOption("--perf")) {
+            if (perf.isAvailable()) {
+                profile.setHardwareCounters(&perf);
+            } else {
+                cout << "Hardware counters unavailable (" << perf.getUnavailableReason() << ").\n";
+            }
+        }
+        size_t walkThreads = optionValue("--walk-threads").empty() ? DirectoryWalker::DEFAULT_THREADS
+                                                                   : stoul(optionValue("--walk-threads"));
+        size_t prefetchWindow = !optionValue("--prefetch").empty() ? stoul(optionValue("--prefetch"))
+                                : hasOption("--prefetch")           ? FilePrefetcher::DEFAULT_WINDOW
+                                                                    : 0;
+        double indexSeconds = indexDirectory(documentParser, PersonTree, OrganizationTree, WordsTree,
+                                             profiling ? &profile : nullptr, hasOption("--records"), walkThreads,
+                                             prefetchWindow, hasOption("--inode-order"));
+        if (!optionValue("--profile").empty()) {
+            ofstream profileFile(optionValue("--profile"));
+            profile.writeJson(profileFile, indexSeconds);
+        }
+
+        // Prune rare terms and promote very common ones to generated stop words.
+        if (!optionValue("--min-df").empty() || !optionValue("--max-df-ratio").empty()) {
+            size_t minDocFrequency = optionValue("--min-df").empty() ? 1 : stoul(optionValue("--min-df"));
+            double maxRatio = optionValue("--max-df-ratio").empty() ? 1.0 : stod(optionValue("--max-df-ratio"));
+
+            // Time the most common words as single-term queries before and after pruning, on the
+            // ranked postings a loaded index would build.
+            vector<const AvlTree<string>*> wordTrees = {&WordsTree};
+            if (hasOption("--partitioned")) {
+                queryProcessor.setPartitionedIndex(&Partitions);
+                wordTrees.clear();
+                for (auto* partition : Partitions.overlapping(DocumentTable::NO_TIMESTAMP, DocumentTable::NO_TIMESTAMP, false)) {
+                    wordTrees.push_back(&partition->WordsTree);
+                }
+            }
+            vector<string> commonTerms = commonWordQueries(wordTrees, 50);
+            queryProcessor.buildRankedPostings();
+            double queryBefore = timeQueries(queryProcessor, commonTerms);
+
+            auto start = chrono::high_resolution_clock::now();
+            DocumentParser::VocabularyPruneStats stats = documentParser.pruneVocabulary(minDocFrequency, maxRatio);
+            chrono::duration<double> duration = chrono::high_resolution_clock::now() - start;
+            queryProcessor.buildRankedPostings();
+            double queryAfter = timeQueries(queryProcessor, commonTerms);
+
+            cout << "Vocabulary pruning took " << duration.count() << " seconds.\n";
+            cout << "Rare terms dropped (df < " << minDocFrequency << "): " << stats.rareTermsDropped << " of "
+                 << stats.termsBefore << "\n";
+            cout << "Terms promoted to stop words (df > " << maxRatio * 100 << "% of documents): "
+                 << stats.stopWordsPromoted << "\n";
+            cout << "Postings removed: " << stats.postingsRemoved << " of " << stats.postingsBefore << " ("
+                 << (stats.postingsBefore ? 100.0 * stats.postingsRemoved / stats.postingsBefore : 0.0) << "%)\n";
+            cout << "Estimated words index memory: " << stats.bytesBefore / 1048576.0 << " -> "
+                 << stats.bytesAfter / 1048576.0 << " MiB\n";
+            cout << commonTerms.size() << " common-term queries took: " << queryBefore << " -> " << queryAfter
+                 << " seconds\n";
+        }
+
+        documentParser.toFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt",
+                              "Trees/documentTable.txt");
+        documentParser.writeGeneratedStopWords("Trees/generatedStopWords.txt");
+        GzipSeekIndex::writeToFile("Trees/gzipSeekPoints.bin");
+        if (budgeted) {
+            const SpimiIndexer::MergeStats& merge = documentParser.getMergeStats();
+            cout << "Sorted runs: " << merge.runs << " (budget " << spimi.getMemoryBudget() / (1 << 20)
+                 << " MiB, largest run estimate " << spimi.getPeakEstimate() / (1 << 20) << " MiB), merged in "
+                 << merge.mergeSeconds << " seconds.\n";
+            cout << "Merged unique names: " << merge.terms[SpimiIndexer::PERSONS] << "\n";
+            cout << "Merged unique organizations: " << merge.terms[SpimiIndexer::ORGANIZATIONS] << "\n";
+            cout << "Merged unique words: " << merge.terms[SpimiIndexer::WORDS] << "\n";
+        }
+
+        // Champion lists and partitions from an earlier build would be stale, so replace them.
+        filesystem::remove("Trees/champions.txt");
+        if (!optionValue("--champions").empty()) {
+            Champions.build(WordsTree, Documents, stoul(optionValue("--champions")), QueryProcessor::STATIC_WEIGHT);
+            Champions.writeToTextFile("Trees/champions.txt");
+            cout << "Terms with champion lists: " << Champions.getSize() << "\n";
+        }
+        filesystem::remove_all("Trees/partitions");
+        if (hasOption("--partitioned")) {
+            Partitions.writeToDirectory("Trees/partitions");
+            cout << "Time partitions: " << Partitions.getSize() << "\n";
+        }
+
+    } else if (command == "query" && argc >= 3) {
         string query = argv[2];
-        queryProcessor.getTreesfromFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt");
-        queryProcessor.runQueryProcessor(query);
+        AllocationTracker::Counts allocationsBefore = AllocationTracker::snapshot();
+        queryProcessor.getTreesfromFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt",
+                                        "Trees/documentTable.txt");
+        loadStopWordLists("Trees");
+        GzipSeekIndex::readFromFile("Trees/gzipSeekPoints.bin");
+        if (filesystem::is_directory("Trees/partitions")) {
+            Partitions.readFromDirectory("Trees/partitions");
+            queryProcessor.setPartitionedIndex(&Partitions);
+        }
+        if (filesystem::exists("Trees/champions.txt")) {
+            Champions.readFromTextFile("Trees/champions.txt");
+            queryProcessor.setChampionLists(&Champions);
+        }
+        queryProcessor.setNewestFirst(hasOption("--newest-first"));
+        QueryExplain explain;
+        bool explaining = hasOption("--explain") || !optionValue("--explain").empty();
+        if (explaining) {
+            queryProcessor.setExplain(&explain);
+        }
+        if (hasOption("--count")) {
+            cout << "Matching documents: " << queryProcessor.countQuery(query) << "\n";
+        } else {
+            queryProcessor.runQueryProcessor(query);
+            if (hasOption("--facets")) {
+                queryProcessor.outputFacets();
+            }
+        }
+        if (!optionValue("--explain").empty()) {
+            ofstream explainFile(optionValue("--explain"));
+            explain.writeJson(explainFile);
+        } else if (explaining) {
+            explain.printTree(cout);
+        }
+        if (AllocationTracker::isEnabled()) {
+            AllocationTracker::printTable(cout, AllocationTracker::snapshot().since(allocationsBefore), 1, "query");
+        }
+
+    } else if (command == "reorder" && argc == 3 && (string(argv[2]) == "url" || string(argv[2]) == "bisect")) {
+        queryProcessor.getTreesfromFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt",
+                                        "Trees/documentTable.txt");
+        GzipSeekIndex::readFromFile("Trees/gzipSeekPoints.bin");
+        reorderIndex(argv[2], queryProcessor, Documents, PersonTree, OrganizationTree, WordsTree);
+        documentParser.toFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt",
+                              "Trees/documentTable.txt");
+
+    } else if (command == "stats" && argc == 2) {
+        size_t residentBeforeLoad = ProcessMemory::currentResidentBytes();
+        queryProcessor.getTreesfromFile("Trees/personTree.txt", "Trees/organizationTree.txt", "Trees/wordsTree.txt",
+                                        "Trees/documentTable.txt");
+        vector<pair<string, vector<const AvlTree<string>*>>> trees = {
+            {"person", {&PersonTree}}, {"organization", {&OrganizationTree}}, {"words", {&WordsTree}}};
+
+        // A partitioned index keeps its postings in the month partitions; each row totals all months
+        if (filesystem::is_directory("Trees/partitions")) {
+            Partitions.readFromDirectory("Trees/partitions");
+            queryProcessor.setPartitionedIndex(&Partitions);
+            vector<TimePartitionedIndex::Partition*> months =
+                Partitions.overlapping(DocumentTable::NO_TIMESTAMP, DocumentTable::NO_TIMESTAMP, false);
+            for (const auto* partition : months) {
+                trees[0].second.push_back(&partition->PersonTree);
+                trees[1].second.push_back(&partition->OrganizationTree);
+                trees[2].second.push_back(&partition->WordsTree);
+            }
+            cout << "Partitioned index: " << months.size() << " month partitions\n";
+        }
+        printIndexStats(trees, Documents, residentBeforeLoad);
 
     } else if (command == "ui" && argc == 2) {
         startUI();
 
     } else {
         cerr << "Invalid command or arguments. See usage:\n"
-             << argv[0] << " index <directory>\n"
-             << argv[0] << " query <query-string>\n"
+             << argv[0] << " index <directory> [--partitioned] [--max-spam=<score>] [--dedupe] [--near-dup=<similarity>]\n"
+             << "      [--min-df=<documents>] [--max-df-ratio=<fraction>] [--champions=<per-term>]\n"
+             << "      [--profile[=<json-file>]] [--perf] [--trace=<json-file>]\n"
+             << "      [--memory-budget=<MiB> [--run-dir=<directory>]] [--records] [--threads=<n>] [--walk-threads=<n>]\n"
+             << "      [--prefetch[=<files>] [--inode-order]]\n"
+             << argv[0] << " query <query-string> [--newest-first] [--facets] [--count] [--explain[=<json-file>]]\n"
+             << "      [--trace=<json-file>]\n"
+             << argv[0] << " reorder <url|bisect>\n"
+             << argv[0] << " stats\n"
              << argv[0] << " ui\n";
         return 1;
     }
 
+    if (!traceFile.empty()) {
+        if (!Trace::writeToFile(traceFile)) {
+            cerr << "Error: Unable to open file " << traceFile << " for writing." << endl;
+            return 1;
+        }
+        cout << "Trace with " << Trace::getEventCount() << " spans written to " << traceFile << "\n";
+    }
     return 0;
 }